@@ -35,6 +35,7 @@ static constexpr int search( float, Status< N >, int newS = State< N, Res< N * r
 }
 
 // compile time factorial iterator
+// Each call yields the next factorial; a stateless table of them is Factorials in compile_time_tables.h
 template< int N = 1 >
 static constexpr int fact_iter( int res = search( N, Status< N >{} ) ) {
    return res;
@@ -3,7 +3,18 @@
 #include <memory>
 #include <utility>
 #include <iostream>
-#include <map>
+#include <tuple>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <type_traits>
 
 /**
  * Типы данных для печати
@@ -56,6 +67,329 @@ struct TwoDesc {
    TwoDesc( const TwoDesc& desc ) : name( desc.name ) {}
 };
 
+/**
+ * Приемник вывода принтеров. Каждый поток пишет в собственный буфер приемника,
+ * а в приемник передаются только заполненные блоки, поэтому потоки не конкурируют
+ * за блокировку потока вывода на каждом вызове печати.
+ * Данные потока попадают в приемник при заполнении блока, вызове flush() или разрушении приемника.
+ */
+class PrintSink {
+public:
+   static constexpr std::size_t BlockSize = 64 << 10;
+
+   /**
+    * Блок текста. Память блока не инициализируется, приемник может забрать ее себе
+    */
+   struct Block {
+      std::unique_ptr< char[] > data;
+      std::size_t size = 0;
+   };
+
+private:
+
+   /**
+    * Буфер потока, оформленный как std::streambuf, чтобы принтеры писали в него через std::ostream
+    */
+   class Buffer : public std::streambuf {
+   public:
+      explicit Buffer( PrintSink& sink ) : m_sink( sink ), m_stream( this ) { reset(); }
+
+      std::ostream& stream() { return m_stream; }
+
+      void append( const char* data, std::size_t size ) {
+         if ( std::size_t( epptr() - pptr() ) < size ) {
+            sputn( data, size );
+            return;
+         }
+         std::memcpy( pptr(), data, size );
+         pbump( int( size ) );
+      }
+
+      char* reserve( std::size_t size ) {
+         if ( std::size_t( epptr() - pptr() ) < size )
+            flush();
+         return pptr();
+      }
+
+      void commit( std::size_t size ) {
+         pbump( int( size ) );
+      }
+
+      void flush() {
+         if ( pptr() == pbase() )
+            return;
+         m_block.size = pptr() - pbase();
+         m_sink.write( m_block );
+         reset();
+      }
+
+   protected:
+      int_type overflow( int_type c ) override {
+         flush();
+         if ( !traits_type::eq_int_type( c, traits_type::eof() ) ) {
+            *pptr() = traits_type::to_char_type( c );
+            pbump( 1 );
+         }
+         return traits_type::not_eof( c );
+      }
+
+      /**
+       * std::endl и std::flush не сбрасывают буфер, сброс выполняется крупными блоками
+       */
+      int sync() override { return 0; }
+
+   private:
+      void reset() {
+         if ( !m_block.data )
+            m_block.data = m_sink.recycle();
+         if ( !m_block.data )
+            m_block.data.reset( new char[ BlockSize ] );
+         m_block.size = 0;
+         setp( m_block.data.get(), m_block.data.get() + BlockSize );
+      }
+
+      PrintSink& m_sink;
+      Block m_block;
+      std::ostream m_stream;
+   };
+
+public:
+   PrintSink() : m_id( nextId() ) {}
+   virtual ~PrintSink() {}
+
+   PrintSink( const PrintSink& ) = delete;
+   PrintSink& operator=( const PrintSink& ) = delete;
+
+   /**
+    * Легкий форматтер поверх буфера потока: строки, символы и целые числа копируются
+    * прямо в блок без форматирования std::ostream, остальные типы выводятся через stream().
+    * signed char и unsigned char, как и в std::ostream, печатаются символами.
+    */
+   class Writer {
+      template< typename T >
+      using IsCharacter = std::integral_constant< bool, std::is_same< T, char >::value ||
+            std::is_same< T, signed char >::value || std::is_same< T, unsigned char >::value >;
+
+      template< typename T >
+      using IsInteger = std::integral_constant< bool, std::is_integral< T >::value &&
+            !IsCharacter< T >::value && !std::is_same< T, bool >::value >;
+
+      template< typename T >
+      using IsText = std::integral_constant< bool, std::is_convertible< const T&, const char* >::value ||
+            std::is_same< T, std::string >::value >;
+
+   public:
+      explicit Writer( Buffer& buffer ) : m_buffer( buffer ) {}
+
+      Writer& operator<<( char c ) {
+         m_buffer.append( &c, 1 );
+         return *this;
+      }
+
+      Writer& operator<<( signed char c ) {
+         return *this << char( c );
+      }
+
+      Writer& operator<<( unsigned char c ) {
+         return *this << char( c );
+      }
+
+      Writer& operator<<( const char* text ) {
+         m_buffer.append( text, std::strlen( text ) );
+         return *this;
+      }
+
+      Writer& operator<<( const std::string& text ) {
+         m_buffer.append( text.data(), text.size() );
+         return *this;
+      }
+
+      template< typename T >
+      auto operator<<( T value ) -> typename std::enable_if< IsInteger< T >::value, Writer& >::type {
+         constexpr std::size_t Digits = std::numeric_limits< T >::digits10 + 3;
+         char* begin = m_buffer.reserve( Digits );
+         m_buffer.commit( std::to_chars( begin, begin + Digits, value ).ptr - begin );
+         return *this;
+      }
+
+      template< typename T >
+      auto operator<<( const T& value ) -> typename std::enable_if< !IsInteger< T >::value && !IsCharacter< T >::value &&
+            !IsText< T >::value, Writer& >::type {
+         m_buffer.stream() << value;
+         return *this;
+      }
+
+      /**
+       * Освобождает в текущем блоке место под size байт (не больше BlockSize),
+       * чтобы короткая пачка записей не разрывалась сбросом блока посередине
+       */
+      void reserve( std::size_t size ) {
+         m_buffer.reserve( size < BlockSize ? size : BlockSize );
+      }
+
+   private:
+      Buffer& m_buffer;
+   };
+
+   /**
+    * Буферизованный поток вывода вызывающего потока
+    */
+   std::ostream& stream() {
+      return buffer().stream();
+   }
+
+   Writer writer() {
+      return Writer( buffer() );
+   }
+
+   /**
+    * Передает в приемник накопленный буфер вызывающего потока
+    */
+   void flush() {
+      buffer().flush();
+   }
+
+protected:
+   /**
+    * Передает в приемник буферы всех потоков. Вызывается наследником в деструкторе,
+    * когда пишущие потоки уже завершили работу с приемником.
+    */
+   void flushAll() {
+      std::lock_guard< std::mutex > lock( m_mutex );
+      for ( auto& buffer : m_buffers )
+         buffer->flush();
+   }
+
+   /**
+    * Получает заполненный блок текста. Если наследник забирает память блока,
+    * следующий блок берется из recycle() или выделяется заново.
+    */
+   virtual void write( Block& block ) = 0;
+
+   /**
+    * Возвращает освободившуюся память блока размером BlockSize, если она есть
+    */
+   virtual std::unique_ptr< char[] > recycle() { return nullptr; }
+
+private:
+   Buffer& buffer() {
+      // --- подряд идущие вызовы почти всегда обращаются к одному приемнику
+      thread_local std::pair< uint64_t, Buffer* > last{ 0, nullptr };
+      if ( last.first == m_id )
+         return *last.second;
+
+      thread_local std::vector< std::pair< uint64_t, Buffer* > > cache;
+      for ( auto& entry : cache ) {
+         if ( entry.first == m_id ) {
+            last = entry;
+            return *entry.second;
+         }
+      }
+
+      std::lock_guard< std::mutex > lock( m_mutex );
+      m_buffers.emplace_back( new Buffer( *this ) );
+      cache.emplace_back( m_id, m_buffers.back().get() );
+      last = cache.back();
+      return *m_buffers.back();
+   }
+
+   static uint64_t nextId() {
+      static std::atomic< uint64_t > id{ 0 };
+      return ++id;
+   }
+
+   const uint64_t m_id;
+   std::mutex m_mutex;
+   std::vector< std::unique_ptr< Buffer > > m_buffers;
+};
+
+/**
+ * Синхронный приемник: блок записывается в поток вывода под блокировкой
+ */
+class StreamSink : public PrintSink {
+public:
+   explicit StreamSink( std::ostream& os = std::cout ) : m_os( os ) {}
+   ~StreamSink() override { flushAll(); }
+
+protected:
+   void write( Block& block ) override {
+      std::lock_guard< std::mutex > lock( m_mutex );
+      m_os.write( block.data.get(), block.size );
+      m_os.flush();
+   }
+
+private:
+   std::ostream& m_os;
+   std::mutex m_mutex;
+};
+
+/**
+ * Асинхронный приемник: заполненные блоки передаются потоку записи через очередь,
+ * а освободившиеся строки возвращаются пишущим потокам для повторного использования.
+ */
+class AsyncSink : public PrintSink {
+public:
+   explicit AsyncSink( std::ostream& os = std::cout ) : m_os( os ), m_thread( &AsyncSink::run, this ) {}
+
+   ~AsyncSink() override {
+      flushAll();
+      {
+         std::lock_guard< std::mutex > lock( m_mutex );
+         m_running = false;
+      }
+      m_ready.notify_one();
+      m_thread.join();
+   }
+
+protected:
+   void write( Block& block ) override {
+      {
+         std::lock_guard< std::mutex > lock( m_mutex );
+         m_queue.push_back( std::move( block ) );
+      }
+      m_ready.notify_one();
+   }
+
+   std::unique_ptr< char[] > recycle() override {
+      std::lock_guard< std::mutex > lock( m_mutex );
+      if ( m_free.empty() )
+         return nullptr;
+      std::unique_ptr< char[] > data = std::move( m_free.back() );
+      m_free.pop_back();
+      return data;
+   }
+
+private:
+   void run() {
+      std::vector< Block > blocks;
+      std::unique_lock< std::mutex > lock( m_mutex );
+      for ( ;; ) {
+         m_ready.wait( lock, [this] { return !m_queue.empty() || !m_running; } );
+         if ( m_queue.empty() )
+            return;
+
+         std::swap( blocks, m_queue );
+         lock.unlock();
+         for ( const auto& block : blocks )
+            m_os.write( block.data.get(), block.size );
+         m_os.flush();
+         lock.lock();
+
+         for ( auto& block : blocks )
+            m_free.push_back( std::move( block.data ) );
+         blocks.clear();
+      }
+   }
+
+   std::ostream& m_os;
+   std::mutex m_mutex;
+   std::condition_variable m_ready;
+   std::vector< Block > m_queue;
+   std::vector< std::unique_ptr< char[] > > m_free;
+   bool m_running = true;
+   std::thread m_thread;
+};
+
 /**
  * Классы принтеры, используются в фабрике для печати аргументов любого типов
  */
@@ -67,17 +401,15 @@ public:
    enum { Zero, One, Two, Nan };
    
    /**
-    * Виртуальный декструктор позволяет освободить ресурсы у наследуемых принтеров
+    * Буферизованный вывод текущего потока исполнения. Фабрика получает его у приемника
+    * один раз на вызов печати и передает по всей цепочке принтеров первым аргументом.
     */
-   virtual ~Printer() {}
-   
+   using Out = PrintSink::Writer;
+
    /**
-    * Метод используется как отправная точка в SFINAE для поиска нужной реализации
+    * Виртуальный декструктор позволяет освободить ресурсы у наследуемых принтеров
     */
-   bool print() { 
-      std::cout << "!" << std::endl;
-      return false; 
-   }
+   virtual ~Printer() {}
 };
 
 
@@ -88,105 +420,189 @@ class PrinterImpl : public Printer {};
 template<>
 class PrinterImpl< Printer::Zero > : public Printer {
 public:
-   bool print( const ZeroDesc& val ) { std::cout << val.name << std::endl; return false; }
-   bool print( const int& val ) { std::cout << "int"; return false; }
-   bool print( const char& val ) { std::cout << "char"; return false; }
+   bool print( Out& out, const ZeroDesc& val ) { out << val.name << '\n'; return false; }
+   bool print( Out& out, const int& val ) { out << "int"; return false; }
+   bool print( Out& out, const char& val ) { out << "char"; return false; }
    
 private:
-   std::unique_ptr< TestData > d{ new TestData( Printer::Zero ) };
+   TestData d{ Printer::Zero };
 };
 
 template<>
 class PrinterImpl< Printer::One > : public Printer {
 public:
-   bool print( const OneDesc& one, const TwoDesc& two ) { std::cout << one.name << " = " << one.val->i << std::endl; return false; }
-   bool print( const int& val ) { std::cout << " = "; return false; }
-   bool print( const char& val ) { std::cout << " = "; return false; }
+   bool print( Out& out, const OneDesc& one, const TwoDesc& two ) { out << one.name << " = " << one.val->i << '\n'; return false; }
+   bool print( Out& out, const int& val ) { out << " = "; return false; }
+   bool print( Out& out, const char& val ) { out << " = "; return false; }
    
 private:
-   std::unique_ptr< TestData > d{ new TestData( Printer::One ) };
+   TestData d{ Printer::One };
 };
 
 template<>
 class PrinterImpl< Printer::Two > : public Printer {
 public:
-   bool print( const ZeroDesc& val ) { std::cout << val.val->i << std::endl; return false; }
-   bool print( const OneDesc& one, const TwoDesc& two ) { std::cout << two.name << " = " << two.val->i << std::endl; return false; }
-   bool print( const int& val ) { std::cout << val << std::endl; return true; }
-   bool print( const char& val ) { std::cout << val << std::endl; return true; }
+   bool print( Out& out, const ZeroDesc& val ) { out << val.val->i << '\n'; return false; }
+   bool print( Out& out, const OneDesc& one, const TwoDesc& two ) { out << two.name << " = " << two.val->i << '\n'; return false; }
+   bool print( Out& out, const int& val ) { out << val << '\n'; return true; }
+   bool print( Out& out, const char& val ) { out << val << '\n'; return true; }
    
 private:
-   std::unique_ptr< TestData > d{ new TestData( Printer::Two ) };
+   TestData d{ Printer::Two };
 };
 
 /**
- * Класс проверяет наличие у принтера метода для печати указанных аргументов
+ * Проверяет наличие у принтера N метода для печати указанных аргументов
  */
-template< int N = Printer::Nan >
-class PrinterPrivate {
-   using PrinterPtr = PrinterImpl< N >*;
+template< int N, typename Signature, typename = void >
+struct CanPrint : std::false_type {};
+
+template< int N, typename ...T >
+struct CanPrint< N, void( T... ), decltype( void( std::declval< PrinterImpl< N >& >().print(
+      std::declval< Printer::Out& >(), std::declval< T >()... ) ) ) > :
+      std::true_type {};
+
+/**
+ * Шаблонная фабрика, использует наследников класса принтера для печати аргументов любого типа
+ */
+class PrinterFactory {
+   using Printers = std::tuple< PrinterImpl< Printer::Zero >, PrinterImpl< Printer::One >, PrinterImpl< Printer::Two > >;
 
 public:
-   PrinterPrivate( Printer* printer ) {
-      m_printer = static_cast< PrinterPtr >( printer );
+   /**
+    * Все принтеры создаются сразу и хранятся внутри объекта фабрики.
+    * Фабрика печатает в указанный приемник, по умолчанию в общий синхронный приемник std::cout.
+    * Несколько потоков могут печатать через одну фабрику, каждый в свой буфер приемника.
+    */
+   explicit PrinterFactory( PrintSink& sink = defaultSink() ) : sink( sink ) {}
+
+   ~PrinterFactory() {
+      flush();
+   }
+
+   static PrintSink& defaultSink() {
+      static StreamSink sink( std::cout );
+      return sink;
    }
 
    /**
-    * Метод использует SFINAE для поиска реализации метода с подходящими типами аргументов
+    * Передает в приемник накопленный вывод вызывающего потока
     */
-   template< typename ...T >
-   auto test_print( T&& ...val ) -> decltype( std::declval< PrinterPtr >()->print( std::forward< T >( val )... ) ) {
-      return m_printer->print( std::forward< T >( val )... );
+   void flush() {
+      sink.flush();
    }
 
    /**
-    * Сюда подставляются все остальные типы аргументов, для которых нет реализации
+    * Печать однородного диапазона: цепочка принтеров выбирается один раз для типа элемента,
+    * буфер вызывающего потока запрашивается у приемника один раз на весь диапазон,
+    * и все элементы пишутся прямо в него.
     */
-   bool test_print( ... ) {
-      return m_printer->Printer::print();
+   template< typename Iterator >
+   void printRange( Iterator begin, Iterator end ) {
+      using Value = decltype( *begin );
+      constexpr int First = nextPrinter< Value >( Printer::Zero );
+      Printer::Out out = sink.writer();
+      out.reserve( rangeBytes( begin, end ) );
+      for ( ; begin != end; ++begin )
+         dispatch< First >( out, *begin );
+   }
+
+   /**
+    * Печать диапазона кортежей, каждый кортеж раскрывается в набор аргументов печати,
+    * например std::vector< std::tuple< OneDesc, TwoDesc > >
+    */
+   template< typename Iterator >
+   void printTuples( Iterator begin, Iterator end ) {
+      using Tuple = typename std::decay< decltype( *begin ) >::type;
+      Printer::Out out = sink.writer();
+      out.reserve( rangeBytes( begin, end ) );
+      for ( ; begin != end; ++begin )
+         printTuple( out, *begin, std::make_index_sequence< std::tuple_size< Tuple >::value >{} );
    }
-   
-private:
-   PrinterPtr m_printer;
-};
 
-/**
- * Шаблонная фабрика, использует наследников класса принтера для печати аргументов любого типа
- */
-class PrinterFactory {
-public:
    /**
     * Главный метод фабрики, который умеет печатать любые типы аргументов
-    * для которых определена реализация в любом из классов принтеров
+    * для которых определена реализация в любом из классов принтеров.
+    * Цепочка подходящих принтеров вычисляется при компиляции, принтеры без
+    * нужной перегрузки пропускаются, и в рантайме остаются только их вызовы.
     */
-   template< int N = Printer::Zero, typename ...T > 
+   template< typename ...T >
    void print( T&& ...val ) {
-      auto& printer = printers[ N ];
-      if ( !printer )
-         printer.reset( new PrinterImpl< N >() );
-      if ( !PrinterPrivate< N >( printer.get() ).test_print( std::forward< T >( val )... ) )
-         print< N + 1, T... >( std::forward< T >( val )... );
+      Printer::Out out = sink.writer();
+      dispatch< nextPrinter< T... >( Printer::Zero ) >( out, std::forward< T >( val )... );
    }
    
    /**
-    * Удаляются все принтеры в рантайме, затем их можно пересоздать заново
+    * Все принтеры пересоздаются без выделения памяти: новый набор строится на стеке
+    * и присваивается принтерам фабрики. Если конструктор принтера бросит исключение,
+    * принтеры фабрики останутся прежними.
     */
+   void reset() {
+      Printers fresh;
+      printers = std::move( fresh );
+   }
+
    void clear() { 
-      printers.clear(); 
+      reset();
    }
 
 private:
-   std::map< int, std::unique_ptr< Printer > > printers;
-};
+   /**
+    * Оценка длины текста одного элемента диапазона для резервирования места в блоке
+    */
+   static constexpr std::size_t ItemBytes = 16;
 
-/**
- * Специализации функции фабрики для различных комбинаций типов аргументов
- */
-template<> void PrinterFactory::print< Printer::Nan >( ZeroDesc&& zero ) {}
-template<> void PrinterFactory::print< Printer::Nan >( ZeroDesc&& zero ) {}
-template<> void PrinterFactory::print< Printer::Nan >( OneDesc&& one, TwoDesc&& two ) {}
-template<> void PrinterFactory::print< Printer::Nan >( int&& val ) {}
-template<> void PrinterFactory::print< Printer::Nan >( char&& val ) {}
+   template< typename Iterator >
+   static auto rangeBytes( Iterator begin, Iterator end ) -> typename std::enable_if< std::is_base_of< std::random_access_iterator_tag,
+         typename std::iterator_traits< Iterator >::iterator_category >::value, std::size_t >::type {
+      return std::size_t( end - begin ) * ItemBytes;
+   }
+
+   template< typename Iterator >
+   static auto rangeBytes( Iterator, Iterator ) -> typename std::enable_if< !std::is_base_of< std::random_access_iterator_tag,
+         typename std::iterator_traits< Iterator >::iterator_category >::value, std::size_t >::type {
+      return 0;
+   }
+
+   template< typename Tuple, std::size_t ...I >
+   void printTuple( Printer::Out& out, Tuple&& tuple, std::index_sequence< I... > ) {
+      constexpr int First = nextPrinter< decltype( std::get< I >( std::forward< Tuple >( tuple ) ) )... >( Printer::Zero );
+      dispatch< First >( out, std::get< I >( std::forward< Tuple >( tuple ) )... );
+   }
+
+   /**
+    * Номер первого принтера, начиная с from, который умеет печатать аргументы, или Printer::Nan
+    */
+   template< typename ...T, std::size_t ...I >
+   static constexpr int nextPrinter( int from, std::index_sequence< I... > ) {
+      constexpr bool can[] = { CanPrint< int( I ), void( T... ) >::value..., false };
+      for ( int n = from; n < Printer::Nan; ++n ) {
+         if ( can[ n ] )
+            return n;
+      }
+      return Printer::Nan;
+   }
+
+   template< typename ...T >
+   static constexpr int nextPrinter( int from ) {
+      return nextPrinter< T... >( from, std::make_index_sequence< Printer::Nan >{} );
+   }
+
+   /**
+    * Звено цепочки: принтер возвращает true, если печать завершена
+    */
+   template< int N, typename ...T >
+   auto dispatch( Printer::Out& out, T&& ...val ) -> typename std::enable_if< N != Printer::Nan >::type {
+      if ( !std::get< N >( printers ).print( out, std::forward< T >( val )... ) )
+         dispatch< nextPrinter< T... >( N + 1 ) >( out, std::forward< T >( val )... );
+   }
+
+   template< int N, typename ...T >
+   auto dispatch( Printer::Out&, T&& ... ) -> typename std::enable_if< N == Printer::Nan >::type {}
+
+   PrintSink& sink;
+   Printers printers;
+};
 
 /**
  * 
@@ -199,5 +615,10 @@ static void testFactory() {
    factory.print( OneDesc(), TwoDesc() );
    factory.print( int( 111 ) );
    factory.print( char('a') );
+
+   std::vector< int > values{ 1, 2, 3 };
+   factory.printRange( values.begin(), values.end() );
+   std::vector< std::tuple< OneDesc, TwoDesc > > pairs( 2 );
+   factory.printTuples( pairs.begin(), pairs.end() );
    factory.clear();
 }
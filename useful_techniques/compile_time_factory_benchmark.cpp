@@ -0,0 +1,149 @@
+#include <iostream>
+
+#include <benchmark/benchmark.h>
+
+#include "compile_time_factory.h"
+
+/**
+ * Прежняя ленивая фабрика для сравнения: принтеры создаются в куче при первом
+ * обращении и хранятся в std::map, очистка освобождает их все.
+ */
+class LazyPrinterFactory {
+public:
+   explicit LazyPrinterFactory( PrintSink& sink ) : sink( sink ) {}
+
+   template< typename ...T >
+   void print( T&& ...val ) {
+      Printer::Out out = sink.writer();
+      print< Printer::Zero >( out, std::forward< T >( val )... );
+   }
+
+   void clear() {
+      printers.clear();
+   }
+
+private:
+   template< int N, typename ...T >
+   auto print( Printer::Out& out, T&& ...val ) -> typename std::enable_if< N != Printer::Nan >::type {
+      auto& printer = printers[ N ];
+      if ( !printer )
+         printer.reset( new PrinterImpl< N >() );
+      if ( !call< N >( static_cast< PrinterImpl< N >* >( printer.get() ), out, std::forward< T >( val )... ) )
+         print< N + 1 >( out, std::forward< T >( val )... );
+   }
+
+   template< int N, typename ...T >
+   auto print( Printer::Out&, T&& ... ) -> typename std::enable_if< N == Printer::Nan >::type {}
+
+   template< int N, typename ...T >
+   static auto call( PrinterImpl< N >* printer, Printer::Out& out, T&& ...val ) ->
+         typename std::enable_if< CanPrint< N, void( T... ) >::value, bool >::type {
+      return printer->print( out, std::forward< T >( val )... );
+   }
+
+   template< int N, typename ...T >
+   static auto call( PrinterImpl< N >*, Printer::Out&, T&& ... ) ->
+         typename std::enable_if< !CanPrint< N, void( T... ) >::value, bool >::type {
+      return false;
+   }
+
+   PrintSink& sink;
+   std::map< int, std::unique_ptr< Printer > > printers;
+};
+
+/**
+ * Печать уходит в поток без буфера, чтобы измерять только работу фабрики
+ */
+static std::ostream& nullStream() {
+   static std::ostream os( nullptr );
+   return os;
+}
+
+static StreamSink& nullSink() {
+   static StreamSink sink( nullStream() );
+   return sink;
+}
+
+/**
+ * Задержка первого вызова: создание фабрики и первая печать
+ */
+template< typename Factory >
+static void FirstCall( benchmark::State& state ) {
+   for ( auto _ : state ) {
+      Factory factory( nullSink() );
+      factory.print( int( 42 ) );
+      benchmark::ClobberMemory();
+   }
+}
+
+/**
+ * Установившийся режим: печать через уже прогретую фабрику
+ */
+template< typename Factory >
+static void SteadyState( benchmark::State& state ) {
+   Factory factory( nullSink() );
+   factory.print( int( 42 ) );
+   for ( auto _ : state ) {
+      factory.print( int( 42 ) );
+      benchmark::ClobberMemory();
+   }
+}
+
+/**
+ * Сброс фабрики и печать после сброса
+ */
+template< typename Factory >
+static void ResetCycle( benchmark::State& state ) {
+   Factory factory( nullSink() );
+   for ( auto _ : state ) {
+      factory.clear();
+      factory.print( int( 42 ) );
+      benchmark::ClobberMemory();
+   }
+}
+
+/**
+ * Печать большого вектора по одному элементу и одним вызовом printRange
+ */
+static void PrintLoop( benchmark::State& state ) {
+   PrinterFactory factory( nullSink() );
+   std::vector< int > values( state.range( 0 ), 42 );
+   for ( auto _ : state ) {
+      for ( int value : values )
+         factory.print( value );
+   }
+   state.SetItemsProcessed( state.iterations() * values.size() );
+}
+
+static void PrintRange( benchmark::State& state ) {
+   PrinterFactory factory( nullSink() );
+   std::vector< int > values( state.range( 0 ), 42 );
+   for ( auto _ : state )
+      factory.printRange( values.begin(), values.end() );
+   state.SetItemsProcessed( state.iterations() * values.size() );
+}
+
+BENCHMARK_TEMPLATE( FirstCall, LazyPrinterFactory );
+BENCHMARK_TEMPLATE( FirstCall, PrinterFactory );
+BENCHMARK_TEMPLATE( SteadyState, LazyPrinterFactory );
+BENCHMARK_TEMPLATE( SteadyState, PrinterFactory );
+BENCHMARK_TEMPLATE( ResetCycle, LazyPrinterFactory );
+BENCHMARK_TEMPLATE( ResetCycle, PrinterFactory );
+BENCHMARK( PrintLoop )->Arg( 1000000 );
+BENCHMARK( PrintRange )->Arg( 1000000 );
+
+int main( int argc, char** argv ) {
+   // --- конструкторы TestData печатают в std::cout, отчет выводится в отдельный поток
+   std::ostream console( std::cout.rdbuf() );
+   std::cout.rdbuf( nullptr );
+
+   benchmark::Initialize( &argc, argv );
+   if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+      return 1;
+
+   benchmark::ConsoleReporter reporter;
+   reporter.SetOutputStream( &console );
+   reporter.SetErrorStream( &std::cerr );
+   benchmark::RunSpecifiedBenchmarks( &reporter );
+   return 0;
+}
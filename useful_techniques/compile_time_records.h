@@ -0,0 +1,236 @@
+#pragma once
+#include <vector>
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+#include "compile_time_typelist.h"
+
+/**
+ * Способ размещения записей в Records.
+ * RowLayout - массив структур: поля одной записи лежат рядом, выгоднее для доступа к записи целиком.
+ * ColumnLayout - структура массивов: каждое поле в собственном массиве, выгоднее для прохода по одному полю.
+ */
+struct RowLayout {};
+struct ColumnLayout {};
+
+/**
+ * Представление одного поля всех записей: элементы с постоянным шагом Stride байт.
+ * Для ColumnLayout шаг равен размеру поля, для RowLayout - размеру записи.
+ */
+template< typename T, size_t Stride >
+class RecordColumn {
+public:
+   class iterator {
+   public:
+      using iterator_category = std::random_access_iterator_tag;
+      using value_type = typename std::remove_const< T >::type;
+      using difference_type = std::ptrdiff_t;
+      using pointer = T*;
+      using reference = T&;
+
+      explicit iterator( T* item = nullptr ) : m_item( item ) {}
+
+      T& operator*() const { return *m_item; }
+      T* operator->() const { return m_item; }
+      T& operator[]( difference_type offset ) const { return *advance( m_item, offset ); }
+      iterator& operator++() { m_item = advance( m_item, 1 ); return *this; }
+      iterator operator++( int ) { iterator copy( *this ); ++*this; return copy; }
+      iterator& operator--() { m_item = advance( m_item, -1 ); return *this; }
+      iterator operator--( int ) { iterator copy( *this ); --*this; return copy; }
+      iterator& operator+=( difference_type offset ) { m_item = advance( m_item, offset ); return *this; }
+      iterator& operator-=( difference_type offset ) { m_item = advance( m_item, -offset ); return *this; }
+      iterator operator+( difference_type offset ) const { return iterator( advance( m_item, offset ) ); }
+      iterator operator-( difference_type offset ) const { return iterator( advance( m_item, -offset ) ); }
+      difference_type operator-( const iterator& other ) const {
+         return ( bytes( m_item ) - bytes( other.m_item ) ) / difference_type( Stride );
+      }
+      bool operator==( const iterator& other ) const { return m_item == other.m_item; }
+      bool operator!=( const iterator& other ) const { return m_item != other.m_item; }
+      bool operator<( const iterator& other ) const { return m_item < other.m_item; }
+
+   private:
+      T* m_item;
+   };
+
+   RecordColumn( T* first, size_t size ) : m_first( first ), m_size( size ) {}
+
+   size_t size() const { return m_size; }
+   T& operator[]( size_t index ) const { return *advance( m_first, std::ptrdiff_t( index ) ); }
+   iterator begin() const { return iterator( m_first ); }
+   iterator end() const { return iterator( advance( m_first, std::ptrdiff_t( m_size ) ) ); }
+
+private:
+   using Byte = typename std::conditional< std::is_const< T >::value, const char, char >::type;
+
+   static Byte* bytes( T* item ) {
+      return reinterpret_cast< Byte* >( item );
+   }
+
+   static T* advance( T* item, std::ptrdiff_t offset ) {
+      return reinterpret_cast< T* >( bytes( item ) + offset * std::ptrdiff_t( Stride ) );
+   }
+
+   T* m_first;
+   size_t m_size;
+};
+
+/**
+ * Контейнер записей с полями из списка типов, размещение выбирается параметром Layout.
+ * List - список Entry или пакет std::tuple. Вызывающий код не зависит от размещения:
+ *
+ *     using Particles = Records< Entry< float, Entry< float, Entry< int, Empty > > >, ColumnLayout >;
+ *     Particles particles;
+ *     particles.append( 1.f, 2.f, 3 );
+ *     for ( float& x : particles.column< 0 >() ) x += 1;   // --- проход по одному полю
+ *     auto row = particles.row( 0 );                        // --- tuple ссылок на поля записи
+ *     std::get< 2 >( row ) = 4;
+ *     particles.get< 1 >( 0 ) = 5.f;
+ *
+ * Ссылки, колонки и строки инвалидируются при изменении числа записей.
+ */
+template< typename List, typename Layout = RowLayout >
+class Records;
+
+template< typename List, typename Layout >
+class Records : public Records< typename Path< List >::value, Layout > {
+   using Records< typename Path< List >::value, Layout >::Records;
+};
+
+template< typename... Fields >
+class Records< std::tuple< Fields... >, RowLayout > {
+   using Indices = std::index_sequence_for< Fields... >;
+
+public:
+   using Record = std::tuple< Fields... >;
+   template< size_t I >
+   using Field = typename std::tuple_element< I, Record >::type;
+
+   size_t size() const { return m_rows.size(); }
+   bool empty() const { return m_rows.empty(); }
+   void resize( size_t size ) { m_rows.resize( size ); }
+   void reserve( size_t size ) { m_rows.reserve( size ); }
+   void clear() { m_rows.clear(); }
+
+   template< typename... Args >
+   void append( Args&&... args ) {
+      static_assert( sizeof...( Args ) == sizeof...( Fields ), "one argument per field" );
+      m_rows.emplace_back( std::forward< Args >( args )... );
+   }
+
+   /* Удаление записи перестановкой с последней */
+   void erase( size_t index ) {
+      if ( index + 1 != m_rows.size() )
+         m_rows[ index ] = std::move( m_rows.back() );
+      m_rows.pop_back();
+   }
+
+   template< size_t I >
+   Field< I >& get( size_t index ) { return std::get< I >( m_rows[ index ] ); }
+
+   template< size_t I >
+   const Field< I >& get( size_t index ) const { return std::get< I >( m_rows[ index ] ); }
+
+   std::tuple< Fields&... > row( size_t index ) { return rowAt( m_rows[ index ], Indices() ); }
+   std::tuple< const Fields&... > row( size_t index ) const { return rowAt( m_rows[ index ], Indices() ); }
+
+   Record record( size_t index ) const { return m_rows[ index ]; }
+
+   template< size_t I >
+   RecordColumn< Field< I >, sizeof( Record ) > column() {
+      return { m_rows.empty() ? nullptr : &std::get< I >( m_rows.front() ), m_rows.size() };
+   }
+
+   template< size_t I >
+   RecordColumn< const Field< I >, sizeof( Record ) > column() const {
+      return { m_rows.empty() ? nullptr : &std::get< I >( m_rows.front() ), m_rows.size() };
+   }
+
+private:
+   template< typename Tuple, size_t... I >
+   static auto rowAt( Tuple& row, std::index_sequence< I... > ) {
+      return std::tie( std::get< I >( row )... );
+   }
+
+   std::vector< Record > m_rows;
+};
+
+template< typename... Fields >
+class Records< std::tuple< Fields... >, ColumnLayout > {
+   static_assert( PackIndex< std::tuple< Fields... >, bool >::value == sizeof...( Fields ),
+         "use char instead of bool: std::vector< bool > has no data()" );
+   using Columns = std::tuple< std::vector< Fields >... >;
+   using Indices = std::index_sequence_for< Fields... >;
+
+public:
+   using Record = std::tuple< Fields... >;
+   template< size_t I >
+   using Field = typename std::tuple_element< I, Record >::type;
+
+   size_t size() const { return m_size; }
+   bool empty() const { return m_size == 0; }
+   void resize( size_t size ) { each( Indices(), [ size ]( auto& column ) { column.resize( size ); } ); m_size = size; }
+   void reserve( size_t size ) { each( Indices(), [ size ]( auto& column ) { column.reserve( size ); } ); }
+   void clear() { each( Indices(), []( auto& column ) { column.clear(); } ); m_size = 0; }
+
+   template< typename... Args >
+   void append( Args&&... args ) {
+      static_assert( sizeof...( Args ) == sizeof...( Fields ), "one argument per field" );
+      appendAt( Indices(), std::forward< Args >( args )... );
+      ++m_size;
+   }
+
+   /* Удаление записи перестановкой с последней */
+   void erase( size_t index ) {
+      const bool last = index + 1 == m_size;
+      each( Indices(), [ index, last ]( auto& column ) {
+         if ( !last )
+            column[ index ] = std::move( column.back() );
+         column.pop_back();
+      } );
+      --m_size;
+   }
+
+   template< size_t I >
+   Field< I >& get( size_t index ) { return std::get< I >( m_columns )[ index ]; }
+
+   template< size_t I >
+   const Field< I >& get( size_t index ) const { return std::get< I >( m_columns )[ index ]; }
+
+   std::tuple< Fields&... > row( size_t index ) { return rowAt( m_columns, index, Indices() ); }
+   std::tuple< const Fields&... > row( size_t index ) const { return rowAt( m_columns, index, Indices() ); }
+
+   Record record( size_t index ) const { return row( index ); }
+
+   template< size_t I >
+   RecordColumn< Field< I >, sizeof( Field< I > ) > column() {
+      return { std::get< I >( m_columns ).data(), m_size };
+   }
+
+   template< size_t I >
+   RecordColumn< const Field< I >, sizeof( Field< I > ) > column() const {
+      return { std::get< I >( m_columns ).data(), m_size };
+   }
+
+private:
+   template< typename Tuple, size_t... I >
+   static auto rowAt( Tuple& columns, size_t index, std::index_sequence< I... > ) {
+      return std::tie( std::get< I >( columns )[ index ]... );
+   }
+
+   template< size_t... I, typename Function >
+   void each( std::index_sequence< I... >, Function&& function ) {
+      int expand[] = { ( function( std::get< I >( m_columns ) ), 0 )..., 0 };
+      (void)expand;
+   }
+
+   template< size_t... I, typename... Args >
+   void appendAt( std::index_sequence< I... >, Args&&... args ) {
+      int expand[] = { ( std::get< I >( m_columns ).emplace_back( std::forward< Args >( args ) ), 0 )..., 0 };
+      (void)expand;
+   }
+
+   Columns m_columns;
+   size_t m_size = 0;
+};
@@ -0,0 +1,95 @@
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "compile_time_records.h"
+
+/**
+ * Частица: координаты, скорость, масса и номер - 8 полей, 36 байт на запись.
+ * Один и тот же код проходов работает с обоими размещениями Records.
+ */
+using Particle = Entry< float, Entry< float, Entry< float,
+      Entry< float, Entry< float, Entry< float,
+      Entry< float, Entry< int, Empty > > > > > > > >;
+
+template< typename Layout >
+static Records< Particle, Layout > makeParticles( size_t count ) {
+   std::mt19937 random( 42 );
+   std::uniform_real_distribution< float > distribution( -1.f, 1.f );
+   Records< Particle, Layout > particles;
+   particles.reserve( count );
+   for ( size_t i = 0; i < count; ++i )
+      particles.append( distribution( random ), distribution( random ), distribution( random ),
+            distribution( random ), distribution( random ), distribution( random ),
+            1.f + distribution( random ), int( i ) );
+   return particles;
+}
+
+/* Сумма одного поля по всем записям */
+template< typename Layout >
+static void ColumnScan( benchmark::State& state ) {
+   auto particles = makeParticles< Layout >( state.range( 0 ) );
+   for ( auto _ : state ) {
+      float sum = 0;
+      for ( float x : particles.template column< 0 >() )
+         sum += x;
+      benchmark::DoNotOptimize( sum );
+   }
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+
+/* Сдвиг координат на скорость: три поля читаются, три пишутся */
+template< typename Layout >
+static void ColumnUpdate( benchmark::State& state ) {
+   auto particles = makeParticles< Layout >( state.range( 0 ) );
+   for ( auto _ : state ) {
+      auto x = particles.template column< 0 >(), y = particles.template column< 1 >(), z = particles.template column< 2 >();
+      auto vx = particles.template column< 3 >(), vy = particles.template column< 4 >(), vz = particles.template column< 5 >();
+      for ( size_t i = 0, size = particles.size(); i < size; ++i ) {
+         x[ i ] += vx[ i ] * 0.01f;
+         y[ i ] += vy[ i ] * 0.01f;
+         z[ i ] += vz[ i ] * 0.01f;
+      }
+      benchmark::ClobberMemory();
+   }
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+
+/* Кинетическая энергия по всем полям записи, записи в случайном порядке */
+template< typename Layout >
+static void RowAccess( benchmark::State& state ) {
+   auto particles = makeParticles< Layout >( state.range( 0 ) );
+   std::vector< size_t > order( particles.size() );
+   for ( size_t i = 0; i < order.size(); ++i )
+      order[ i ] = i;
+   std::shuffle( order.begin(), order.end(), std::mt19937( 7 ) );
+
+   for ( auto _ : state ) {
+      float energy = 0;
+      for ( size_t index : order ) {
+         auto row = particles.row( index );
+         const float vx = std::get< 3 >( row ), vy = std::get< 4 >( row ), vz = std::get< 5 >( row );
+         energy += std::get< 6 >( row ) * ( vx * vx + vy * vy + vz * vz ) * float( std::get< 7 >( row ) & 1 )
+               + std::get< 0 >( row ) + std::get< 1 >( row ) + std::get< 2 >( row );
+      }
+      benchmark::DoNotOptimize( energy );
+   }
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+
+#define RECORDS_BENCHMARK( Name ) \
+   BENCHMARK_TEMPLATE( Name, RowLayout )->Arg( 1 << 10 )->Arg( 1 << 20 ); \
+   BENCHMARK_TEMPLATE( Name, ColumnLayout )->Arg( 1 << 10 )->Arg( 1 << 20 )
+
+RECORDS_BENCHMARK( ColumnScan );
+RECORDS_BENCHMARK( ColumnUpdate );
+RECORDS_BENCHMARK( RowAccess );
+
+int main( int argc, char** argv ) {
+   benchmark::Initialize( &argc, argv );
+   if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+      return 1;
+
+   benchmark::RunSpecifiedBenchmarks();
+   return 0;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <type_traits>
+
+/**
+ * Utility stuff.
+ */
+template< std::size_t Index >
+struct size_t_ : std::integral_constant< std::size_t, Index > {
+};
+
+/**
+ * Ячейка счетчика: специализация counter_slot< Tag, Value > объявляется, когда счетчик достигает Value.
+ * Специализация содержит дружественную перегрузку counter_reminder, которая находится только
+ * поиском по аргументу (ADL) для указателя на эту ячейку. Поэтому при проверке разряда
+ * в разрешении перегрузки участвуют не более двух функций, сколько бы раз ни увеличивался счетчик.
+ * Если ячейка не объявлена, общий шаблон возвращает Value без младшего разряда,
+ * то есть уже найденные старшие разряды.
+ * GCC хранит скрытые дружественные функции в общем списке имени counter_reminder и просматривает
+ * его при поиске, поэтому на десятках тысяч увеличений время чтения снова растет с их числом.
+ */
+template< typename Tag, std::size_t Value >
+struct counter_slot;
+
+template< typename Tag, std::size_t Value >
+constexpr size_t_< Value & ( Value - 1 ) > counter_reminder( counter_slot< Tag, Value >* ) {
+    return {};
+}
+
+/**
+ * Макросы для чтение значения счетчика времени компиляции.
+ * Каждый счетчик характеризуется собственным тегом.
+ * Чтение проверяет разряды от старшего к младшему, по одному разрешению перегрузки на разряд.
+ * Цепочка COUNTER_READ_N принимает макрос проверки разряда, поэтому годится и для счетчиков
+ * с другой функцией-напоминанием: у каждой функции свой список скрытых друзей в GCC.
+ * Число разрядов задается COUNTER_MAX_BITS (от 1 до 24), максимальное значение счетчика
+ * равно 2^COUNTER_MAX_BITS - 1. Меньшее число разрядов ускоряет компиляцию.
+ */
+#ifndef COUNTER_MAX_BITS
+#define COUNTER_MAX_BITS 16
+#endif
+
+#define PACK_ARGS( ... ) __VA_ARGS__
+#define COUNTER_CONCAT( Left, Right ) COUNTER_CONCAT_BASE( Left, Right )
+#define COUNTER_CONCAT_BASE( Left, Right ) Left##Right
+
+#define COUNTER_READ_BASE( Tag, Base, Tail ) \
+counter_reminder( static_cast< counter_slot< PACK_ARGS( Tag ), ( Base ) | ( Tail ) >* >( nullptr ) )
+
+#define COUNTER_READ_1( Read, Tag, Tail ) Read( PACK_ARGS( Tag ), 0x1, Tail )
+#define COUNTER_READ_2( Read, Tag, Tail ) COUNTER_READ_1( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x2, Tail ) )
+#define COUNTER_READ_3( Read, Tag, Tail ) COUNTER_READ_2( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x4, Tail ) )
+#define COUNTER_READ_4( Read, Tag, Tail ) COUNTER_READ_3( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x8, Tail ) )
+#define COUNTER_READ_5( Read, Tag, Tail ) COUNTER_READ_4( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x10, Tail ) )
+#define COUNTER_READ_6( Read, Tag, Tail ) COUNTER_READ_5( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x20, Tail ) )
+#define COUNTER_READ_7( Read, Tag, Tail ) COUNTER_READ_6( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x40, Tail ) )
+#define COUNTER_READ_8( Read, Tag, Tail ) COUNTER_READ_7( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x80, Tail ) )
+#define COUNTER_READ_9( Read, Tag, Tail ) COUNTER_READ_8( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x100, Tail ) )
+#define COUNTER_READ_10( Read, Tag, Tail ) COUNTER_READ_9( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x200, Tail ) )
+#define COUNTER_READ_11( Read, Tag, Tail ) COUNTER_READ_10( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x400, Tail ) )
+#define COUNTER_READ_12( Read, Tag, Tail ) COUNTER_READ_11( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x800, Tail ) )
+#define COUNTER_READ_13( Read, Tag, Tail ) COUNTER_READ_12( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x1000, Tail ) )
+#define COUNTER_READ_14( Read, Tag, Tail ) COUNTER_READ_13( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x2000, Tail ) )
+#define COUNTER_READ_15( Read, Tag, Tail ) COUNTER_READ_14( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x4000, Tail ) )
+#define COUNTER_READ_16( Read, Tag, Tail ) COUNTER_READ_15( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x8000, Tail ) )
+#define COUNTER_READ_17( Read, Tag, Tail ) COUNTER_READ_16( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x10000, Tail ) )
+#define COUNTER_READ_18( Read, Tag, Tail ) COUNTER_READ_17( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x20000, Tail ) )
+#define COUNTER_READ_19( Read, Tag, Tail ) COUNTER_READ_18( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x40000, Tail ) )
+#define COUNTER_READ_20( Read, Tag, Tail ) COUNTER_READ_19( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x80000, Tail ) )
+#define COUNTER_READ_21( Read, Tag, Tail ) COUNTER_READ_20( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x100000, Tail ) )
+#define COUNTER_READ_22( Read, Tag, Tail ) COUNTER_READ_21( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x200000, Tail ) )
+#define COUNTER_READ_23( Read, Tag, Tail ) COUNTER_READ_22( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x400000, Tail ) )
+#define COUNTER_READ_24( Read, Tag, Tail ) COUNTER_READ_23( Read, PACK_ARGS( Tag ), Read( PACK_ARGS( Tag ), 0x800000, Tail ) )
+
+#define COUNTER_READ( Tag ) \
+COUNTER_CONCAT( COUNTER_READ_, COUNTER_MAX_BITS )( COUNTER_READ_BASE, PACK_ARGS( Tag ), 0 )
+
+/**
+ * Увеличение счетчика. COUNTER_INC_FROM принимает уже прочитанное значение счетчика,
+ * COUNTER_INC читает его один раз и запоминает в псевдониме с уникальным именем.
+ */
+#define COUNTER_INC_FROM( Tag, Value ) \
+template<> \
+struct counter_slot< PACK_ARGS( Tag ), ( Value ) + 1 > { \
+    static_assert( ( Value ) + 1 < ( std::size_t( 1 ) << COUNTER_MAX_BITS ), "counter overflow, raise COUNTER_MAX_BITS" ); \
+    friend constexpr size_t_< ( Value ) + 1 > counter_reminder( counter_slot* ) { return {}; } \
+};
+
+#define COUNTER_INC( Tag ) \
+COUNTER_INC_NAMED( PACK_ARGS( Tag ), COUNTER_CONCAT( counter_value_, __COUNTER__ ) )
+
+#define COUNTER_INC_NAMED( Tag, Name ) \
+using Name = size_t_< COUNTER_READ( PACK_ARGS( Tag ) ) >; \
+COUNTER_INC_FROM( PACK_ARGS( Tag ), Name::value )
+
+/**
+ * Регистрация типов с плотными идентификаторами времени компиляции.
+ * REGISTER_TYPE( Tag, Type ) выдает типу следующий номер счетчика Tag, начиная с нуля:
+ *
+ *     struct Shapes {};
+ *     REGISTER_TYPE( Shapes, Circle )             // --- TypeId< Shapes, Circle >::value == 0
+ *     REGISTER_TYPE( Shapes, Square )             // --- TypeId< Shapes, Square >::value == 1
+ *     using All = TypePack< Shapes, TYPE_COUNT( Shapes ) >;   // --- std::tuple< Circle, Square >
+ *
+ * Номера зависят только от порядка регистраций, поэтому совпадают во всех единицах трансляции,
+ * включающих один и тот же заголовок с регистрациями. Все вычисляется при компиляции и годится
+ * как индекс массива или параметр шаблона. Обращение к TypeId незарегистрированного типа
+ * не компилируется. Макрос используется в глобальном пространстве имен, тип задается полным именем
+ * и может содержать запятые.
+ */
+template< typename Tag, typename Type >
+struct TypeId;
+
+template< typename Tag, std::size_t Id >
+struct TypeAt;
+
+#define REGISTER_TYPE( Tag, ... ) \
+REGISTER_TYPE_NAMED( PACK_ARGS( Tag ), COUNTER_CONCAT( registered_type_, __COUNTER__ ), __VA_ARGS__ )
+
+#define REGISTER_TYPE_NAMED( Tag, Ident, ... ) \
+using Ident = size_t_< COUNTER_READ( PACK_ARGS( Tag ) ) >; \
+template<> \
+struct TypeId< PACK_ARGS( Tag ), __VA_ARGS__ > : size_t_< Ident::value > {}; \
+template<> \
+struct TypeAt< PACK_ARGS( Tag ), Ident::value > { \
+    using value = __VA_ARGS__; \
+}; \
+COUNTER_INC_FROM( PACK_ARGS( Tag ), Ident::value )
+
+/* Число типов, зарегистрированных под Tag к месту использования */
+#define TYPE_COUNT( Tag ) COUNTER_READ( PACK_ARGS( Tag ) )
+
+template< typename Tag, typename Sequence >
+struct TypePackImpl;
+
+template< typename Tag, std::size_t... Id >
+struct TypePackImpl< Tag, std::index_sequence< Id... > > {
+    using value = std::tuple< typename TypeAt< Tag, Id >::value... >;
+};
+
+template< typename Tag, std::size_t Count >
+using TypePack = typename TypePackImpl< Tag, std::make_index_sequence< Count > >::value;
@@ -0,0 +1,89 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Замер времени и памяти компиляции регистрации типов.
+
+Для каждого числа регистраций генерируется единица трансляции:
+    counter_id - прежний счетчик counter_id() из compile_time_counter.h, по вызову на регистрацию;
+    register   - REGISTER_TYPE из compile_time_registry.h для разных типов и TypePack по всем типам.
+
+В обоих вариантах проверяется, что последняя регистрация получила ожидаемый номер.
+Столбец value показывает, выполнилась ли проверка: на GCC 12 counter_id() возвращает одно и то же значение.
+
+Пример запуска:
+    python compile_time_registry_benchmark.py --counts 100 1000 --cxx g++
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def counter_id_source(count):
+    lines = ['#include "compile_time_counter.h"']
+    lines += ['static constexpr int id%d = counter_id();' % i for i in range(count)]
+    lines.append('static_assert( id%d == id0 + %d, "value" );' % (count - 1, count - 1))
+    lines.append('int main() { return id0; }')
+    return '\n'.join(lines) + '\n'
+
+
+def register_source(count):
+    lines = ['#include "compile_time_registry.h"', 'template< int N > struct T {};', 'struct Tag {};']
+    lines += ['REGISTER_TYPE( Tag, T< %d > )' % i for i in range(count)]
+    lines.append('static_assert( TypeId< Tag, T< %d > >::value == %d, "value" );' % (count - 1, count - 1))
+    lines.append('static_assert( std::tuple_size< TypePack< Tag, TYPE_COUNT( Tag ) > >::value == %d, "value" );'
+                 % count)
+    lines.append('int main() { return 0; }')
+    return '\n'.join(lines) + '\n'
+
+
+SOURCES = {'counter_id': counter_id_source, 'register': register_source}
+
+
+def compile_once(cxx, flags, directory, source):
+    path = os.path.join(directory, 'main.cpp')
+    with open(path, 'w') as file:
+        file.write(source)
+
+    command = [cxx, '-std=c++14', '-fsyntax-only', '-w', '-I', HERE] + flags + [path]
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = process.stderr.read().decode(errors='replace')
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    errors = [line for line in stderr.splitlines() if 'error' in line]
+    if status != 0 and not all('"value"' in line or 'static assertion failed' in line for line in errors):
+        return None, errors[:1]
+    return (elapsed, usage.ru_maxrss / 1024., status == 0), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--counts', type=int, nargs='+', default=[100, 1000])
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'))
+    parser.add_argument('--variants', nargs='+', default=['counter_id', 'register'])
+    parser.add_argument('flags', nargs='*', help='дополнительные флаги компилятора')
+    args = parser.parse_args()
+
+    print('%-12s %8s %10s %10s %8s' % ('variant', 'count', 'time, s', 'rss, MiB', 'value'))
+    for variant in args.variants:
+        for count in args.counts:
+            with tempfile.TemporaryDirectory() as directory:
+                result, errors = compile_once(args.cxx, args.flags, directory, SOURCES[variant](count))
+
+            if result is None:
+                print('%-12s %8d %10s %10s %8s  %s' % (variant, count, 'error', '-', '-', ' / '.join(errors)[:120]))
+            else:
+                print('%-12s %8d %10.2f %10.1f %8s' % (variant, count, result[0], result[1],
+                                                       'ok' if result[2] else 'wrong'))
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -3,6 +3,23 @@
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <sstream>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstring>
+#include <cstdlib>
+#include <new>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <stdexcept>
+
+#include "compile_time_registry.h"
 
 /**
  *
@@ -32,25 +49,884 @@ std::ostream& operator<<( std::ostream& os, const std::shared_ptr< TestData >& t
 template< typename Type >
 struct TypeStorage : public Type::Storage {};
 
+/**
+ * Хранилища объектов реестра. Каждое хранилище повторяет минимальный интерфейс std::map:
+ * emplace( key, value ) -> pair< iterator, bool >, find( key ), end() и mapped_type.
+ * В отличие от std::map, итераторы открытых хранилищ инвалидируются при вставке.
+ */
+template< typename Key, typename Value >
+using MapBackend = std::map< Key, Value >;
+
+/**
+ * Итератор по занятым ячейкам открытых хранилищ, пропускает пустые ячейки.
+ */
+template< typename Slot >
+class SlotIterator {
+public:
+   SlotIterator( Slot* slot, const uint8_t* used, const uint8_t* last ) :
+         m_slot( slot ), m_used( used ), m_last( last ) { skip(); }
+
+   Slot& operator*() const { return *m_slot; }
+   Slot* operator->() const { return m_slot; }
+   SlotIterator& operator++() { ++m_slot; ++m_used; skip(); return *this; }
+   bool operator==( const SlotIterator& it ) const { return m_slot == it.m_slot; }
+   bool operator!=( const SlotIterator& it ) const { return m_slot != it.m_slot; }
+
+private:
+   void skip() { while ( m_used != m_last && !*m_used ) { ++m_slot; ++m_used; } }
+
+   Slot* m_slot;
+   const uint8_t* m_used;
+   const uint8_t* m_last;
+};
+
+/**
+ * Хеш-таблица с открытой адресацией и линейным пробированием.
+ * Ключи и значения лежат в одном непрерывном массиве, поиск не ходит по указателям.
+ */
+template< typename Key, typename Value >
+class FlatHashBackend {
+public:
+   using key_type = Key;
+   using mapped_type = Value;
+   using value_type = std::pair< Key, Value >;
+
+   using iterator = SlotIterator< value_type >;
+
+   iterator begin() { return at( 0 ); }
+   iterator end() { return at( m_slots.size() ); }
+   std::size_t size() const { return m_size; }
+
+   iterator find( const Key& key ) {
+      if ( m_size == 0 )
+         return end();
+      for ( std::size_t i = hash( key ); m_used[ i ]; i = ( i + 1 ) & m_mask ) {
+         if ( m_slots[ i ].first == key )
+            return at( i );
+      }
+      return end();
+   }
+
+   template< typename ...Args >
+   std::pair< iterator, bool > emplace( const Key& key, Args&& ...args ) {
+      // --- коэффициент заполнения не превышает 1/2, чтобы цепочки пробирования оставались короткими
+      if ( ( m_size + 1 ) * 2 > m_slots.size() )
+         rehash( std::max< std::size_t >( 16, m_slots.size() * 2 ) );
+
+      std::size_t i = hash( key );
+      for ( ; m_used[ i ]; i = ( i + 1 ) & m_mask ) {
+         if ( m_slots[ i ].first == key )
+            return { at( i ), false };
+      }
+      m_slots[ i ] = value_type( key, Value( std::forward< Args >( args )... ) );
+      m_used[ i ] = 1;
+      ++m_size;
+      return { at( i ), true };
+   }
+
+   void reserve( std::size_t count ) {
+      std::size_t capacity = 16;
+      while ( capacity < count * 2 )
+         capacity *= 2;
+      if ( capacity > m_slots.size() )
+         rehash( capacity );
+   }
+
+private:
+   iterator at( std::size_t i ) {
+      return iterator( m_slots.data() + i, m_used.data() + i, m_used.data() + m_used.size() );
+   }
+
+   std::size_t hash( const Key& key ) const {
+      // --- мультипликативное хеширование Фибоначчи, берутся старшие биты произведения
+      return std::size_t( ( uint64_t( key ) * 0x9E3779B97F4A7C15ull ) >> m_shift ) & m_mask;
+   }
+
+   void rehash( std::size_t capacity ) {
+      std::vector< value_type > slots( capacity );
+      std::vector< uint8_t > used( capacity, 0 );
+      std::swap( slots, m_slots );
+      std::swap( used, m_used );
+      m_mask = capacity - 1;
+      m_shift = 64;
+      for ( std::size_t c = capacity; c > 1; c >>= 1 )
+         --m_shift;
+
+      for ( std::size_t j = 0; j < slots.size(); ++j ) {
+         if ( !used[ j ] )
+            continue;
+         std::size_t i = hash( slots[ j ].first );
+         while ( m_used[ i ] )
+            i = ( i + 1 ) & m_mask;
+         m_slots[ i ] = std::move( slots[ j ] );
+         m_used[ i ] = 1;
+      }
+   }
+
+   std::vector< value_type > m_slots;
+   std::vector< uint8_t > m_used;
+   std::size_t m_size = 0;
+   std::size_t m_mask = 0;
+   unsigned m_shift = 64;
+};
+
+/**
+ * Плотный массив для небольших непрерывных диапазонов идентификаторов [ Base, Base + N ).
+ * Поиск сводится к одному индексированию, память расходуется на весь диапазон.
+ * Вставка ключа меньше Base бросает std::out_of_range.
+ */
+template< typename Key, typename Value, Key Base = 0 >
+class DenseVectorBackend {
+public:
+   using key_type = Key;
+   using mapped_type = Value;
+   using value_type = std::pair< Key, Value >;
+
+   using iterator = SlotIterator< value_type >;
+
+   iterator begin() { return at( 0 ); }
+   iterator end() { return at( m_slots.size() ); }
+   std::size_t size() const { return m_size; }
+
+   iterator find( const Key& key ) {
+      std::size_t i = std::size_t( key - Base );
+      if ( key < Base || i >= m_slots.size() || !m_used[ i ] )
+         return end();
+      return at( i );
+   }
+
+   template< typename ...Args >
+   std::pair< iterator, bool > emplace( const Key& key, Args&& ...args ) {
+      // --- ключ ниже Base превратился бы в индекс около 2^64
+      if ( key < Base )
+         throw std::out_of_range( "DenseVectorBackend: key is below Base" );
+      std::size_t i = std::size_t( key - Base );
+      if ( i >= m_slots.size() ) {
+         m_slots.resize( std::max( i + 1, m_slots.size() * 2 ) );
+         m_used.resize( m_slots.size(), 0 );
+      }
+      if ( m_used[ i ] )
+         return { at( i ), false };
+
+      m_slots[ i ] = value_type( key, Value( std::forward< Args >( args )... ) );
+      m_used[ i ] = 1;
+      ++m_size;
+      return { at( i ), true };
+   }
+
+   void reserve( std::size_t count ) {
+      m_slots.reserve( count );
+      m_used.reserve( count );
+   }
+
+private:
+   iterator at( std::size_t i ) {
+      return iterator( m_slots.data() + i, m_used.data() + i, m_used.data() + m_used.size() );
+   }
+
+   std::vector< value_type > m_slots;
+   std::vector< uint8_t > m_used;
+   std::size_t m_size = 0;
+};
+
+/**
+ * Хранилище с совершенным хешированием для идентификаторов, известных на этапе компиляции.
+ * Таблица строится constexpr методом hash-and-displace (CHD): идентификаторы раскладываются
+ * по корзинам, и для каждой корзины, начиная с самых больших, подбирается затравка хеш-функции,
+ * при которой все ее идентификаторы попадают в свободные ячейки. Перебор затравок ограничен,
+ * при неудаче (например, из-за повторяющихся идентификаторов) сборка останавливается static_assert.
+ * Для идентификаторов Ids доступ сводится к двум хешам и одному индексированию,
+ * а emplace< Id >() вычисляет индекс ячейки еще при компиляции.
+ * Остальные идентификаторы, пришедшие в рантайме, хранятся в FlatHashBackend.
+ * Итераторы являются указателями на элементы и инвалидируются при вставке в резервную таблицу.
+ */
+template< typename Key, typename Value, Key ...Ids >
+class PerfectHashBackend {
+   static constexpr std::size_t Count = sizeof...( Ids );
+
+   static constexpr std::size_t log2ceil( std::size_t n ) {
+      std::size_t b = 1;
+      while ( ( std::size_t( 1 ) << b ) < n )
+         ++b;
+      return b;
+   }
+
+   // --- ячеек вдвое больше идентификаторов, в корзине в среднем два идентификатора
+   static constexpr std::size_t Bits = log2ceil( Count * 2 );
+   static constexpr std::size_t Size = std::size_t( 1 ) << Bits;
+   static constexpr std::size_t BucketBits = log2ceil( Count / 2 );
+   static constexpr std::size_t Buckets = std::size_t( 1 ) << BucketBits;
+   static constexpr uint32_t MaxSeed = 1u << 16;
+
+   struct Layout {
+      bool built = false;
+      uint32_t seeds[ Buckets ] = {};
+      Key keys[ Size ] = {};
+      bool present[ Size ] = {};
+   };
+
+   static constexpr uint64_t mix( uint64_t x ) {
+      x ^= x >> 31;
+      x *= 0xBF58476D1CE4E5B9ull;
+      x ^= x >> 29;
+      return x;
+   }
+
+   static constexpr std::size_t bucket( Key key ) {
+      return std::size_t( ( uint64_t( key ) * 0x9E3779B97F4A7C15ull ) >> ( 64 - BucketBits ) );
+   }
+
+   static constexpr std::size_t hash( Key key, uint32_t seed ) {
+      return std::size_t( mix( uint64_t( key ) ^ ( uint64_t( seed ) * 0x9E3779B97F4A7C15ull ) ) >> ( 64 - Bits ) );
+   }
+
+   static constexpr bool place( Layout& result, const Key* members, std::size_t count, uint32_t seed ) {
+      for ( std::size_t j = 0; j < count; ++j ) {
+         std::size_t i = hash( members[ j ], seed );
+         if ( result.present[ i ] ) {
+            // --- откат уже занятых корзиной ячеек, в том числе при совпадении внутри корзины
+            for ( std::size_t k = 0; k < j; ++k )
+               result.present[ hash( members[ k ], seed ) ] = false;
+            return false;
+         }
+         result.keys[ i ] = members[ j ];
+         result.present[ i ] = true;
+      }
+      return true;
+   }
+
+   static constexpr Layout layout() {
+      constexpr Key ids[ Count + 1 ] = { Ids..., Key() };
+      // --- идентификаторы группируются по корзинам подсчетом, корзина b занимает [ first[ b ], first[ b + 1 ] )
+      std::size_t first[ Buckets + 1 ] = {};
+      for ( std::size_t j = 0; j < Count; ++j )
+         ++first[ bucket( ids[ j ] ) + 1 ];
+      std::size_t largest = 0;
+      for ( std::size_t b = 0; b < Buckets; ++b ) {
+         largest = std::max( largest, first[ b + 1 ] );
+         first[ b + 1 ] += first[ b ];
+      }
+      Key grouped[ Count + 1 ] = {};
+      std::size_t filled[ Buckets ] = {};
+      for ( std::size_t j = 0; j < Count; ++j ) {
+         std::size_t b = bucket( ids[ j ] );
+         grouped[ first[ b ] + filled[ b ]++ ] = ids[ j ];
+      }
+
+      Layout result;
+      // --- большие корзины размещаются первыми, пока таблица почти пуста
+      for ( std::size_t size = largest; size > 0; --size ) {
+         for ( std::size_t b = 0; b < Buckets; ++b ) {
+            if ( filled[ b ] != size )
+               continue;
+            uint32_t seed = 0;
+            while ( seed < MaxSeed && !place( result, grouped + first[ b ], size, seed ) )
+               ++seed;
+            if ( seed == MaxSeed )
+               return result;
+            result.seeds[ b ] = seed;
+         }
+      }
+      result.built = true;
+      return result;
+   }
+
+   static constexpr Layout Table = layout();
+   static_assert( Table.built, "perfect hash construction failed: type ids must be distinct" );
+
+   static constexpr std::size_t index( Key key ) {
+      return hash( key, Table.seeds[ bucket( key ) ] );
+   }
+
+   static constexpr bool registered( Key key ) {
+      return Table.present[ index( key ) ] && Table.keys[ index( key ) ] == key;
+   }
+
+public:
+   using key_type = Key;
+   using mapped_type = Value;
+   using value_type = std::pair< Key, Value >;
+   using iterator = value_type*;
+
+   iterator end() { return nullptr; }
+
+   iterator find( const Key& key ) {
+      std::size_t i = index( key );
+      if ( Table.present[ i ] && Table.keys[ i ] == key )
+         return m_used[ i ] ? &m_slots[ i ] : end();
+      auto it = m_fallback.find( key );
+      return it != m_fallback.end() ? &*it : end();
+   }
+
+   template< typename ...Args >
+   std::pair< iterator, bool > emplace( const Key& key, Args&& ...args ) {
+      std::size_t i = index( key );
+      if ( Table.present[ i ] && Table.keys[ i ] == key )
+         return emplaceAt( i, key, std::forward< Args >( args )... );
+      auto it = m_fallback.emplace( key, std::forward< Args >( args )... );
+      return { &*it.first, it.second };
+   }
+
+   /**
+    * Вставка по идентификатору, известному при компиляции, без вычисления хеша в рантайме.
+    * Для незарегистрированного Id перегрузка исключается, и getTypePtr уходит в emplace( key ).
+    */
+   template< Key Id, typename ...Args >
+   auto emplace( Args&& ...args ) -> std::enable_if_t< registered( Id ), std::pair< iterator, bool > > {
+      constexpr std::size_t i = index( Id );
+      return emplaceAt( i, Id, std::forward< Args >( args )... );
+   }
+
+private:
+   template< typename ...Args >
+   std::pair< iterator, bool > emplaceAt( std::size_t i, const Key& key, Args&& ...args ) {
+      if ( m_used[ i ] )
+         return { &m_slots[ i ], false };
+      m_slots[ i ] = value_type( key, Value( std::forward< Args >( args )... ) );
+      m_used[ i ] = true;
+      return { &m_slots[ i ], true };
+   }
+
+   value_type m_slots[ Size ];
+   bool m_used[ Size ] = {};
+   FlatHashBackend< Key, Value > m_fallback;
+};
+
+template< typename Key, typename Value, Key ...Ids >
+constexpr typename PerfectHashBackend< Key, Value, Ids... >::Layout PerfectHashBackend< Key, Value, Ids... >::Table;
+
+/**
+ * Список типов реестра с идентификаторами времени компиляции Type::typeId().
+ * Backend подставляется в StorageTraits: StorageTraits< CType, RegisteredTypes< ... >::Backend >.
+ */
+template< typename ...Types >
+struct RegisteredTypes {
+   template< typename Key, typename Value >
+   using Backend = PerfectHashBackend< Key, Value, Key( Types::typeId() )... >;
+};
+
+/**
+ * Проверка построения таблицы для случайных несмежных идентификаторов
+ */
+constexpr int randomTypeId( std::size_t i ) {
+   // --- биекция на uint32_t, поэтому идентификаторы различны
+   uint32_t x = uint32_t( i ) * 0x9E3779B1u;
+   x ^= x >> 15;
+   x *= 0x2C1B3C6Du;
+   x ^= x >> 12;
+   return int( x );
+}
+
+template< typename Sequence >
+struct RandomIdsBackend;
+
+template< std::size_t ...I >
+struct RandomIdsBackend< std::index_sequence< I... > > {
+   using type = PerfectHashBackend< int, std::shared_ptr< int >, randomTypeId( I )... >;
+};
+
+/**
+ * Хранилище для плотных идентификаторов [ 0, Count ), выданных REGISTER_TYPE из compile_time_registry.h.
+ * Идентификатор сразу является индексом ячейки: поиск - одна проверка диапазона,
+ * emplace< Id >() проверяет диапазон при компиляции. Остальные идентификаторы хранятся в FlatHashBackend.
+ * Итераторы являются указателями на элементы и инвалидируются при вставке в резервную таблицу.
+ */
+template< typename Key, typename Value, std::size_t Count >
+class DenseIdBackend {
+public:
+   using key_type = Key;
+   using mapped_type = Value;
+   using value_type = std::pair< Key, Value >;
+   using iterator = value_type*;
+
+   iterator end() { return nullptr; }
+
+   iterator find( const Key& key ) {
+      if ( std::size_t( key ) < Count )
+         return m_used[ std::size_t( key ) ] ? &m_slots[ std::size_t( key ) ] : end();
+      auto it = m_fallback.find( key );
+      return it != m_fallback.end() ? &*it : end();
+   }
+
+   template< typename ...Args >
+   std::pair< iterator, bool > emplace( const Key& key, Args&& ...args ) {
+      if ( std::size_t( key ) < Count )
+         return emplaceAt( std::size_t( key ), key, std::forward< Args >( args )... );
+      auto it = m_fallback.emplace( key, std::forward< Args >( args )... );
+      return { &*it.first, it.second };
+   }
+
+   /**
+    * Вставка по идентификатору, известному при компиляции.
+    * Для Id вне диапазона перегрузка исключается, и getTypePtr уходит в emplace( key ).
+    */
+   template< Key Id, typename ...Args >
+   auto emplace( Args&& ...args ) -> std::enable_if_t< ( std::size_t( Id ) < Count ), std::pair< iterator, bool > > {
+      return emplaceAt( std::size_t( Id ), Id, std::forward< Args >( args )... );
+   }
+
+private:
+   template< typename ...Args >
+   std::pair< iterator, bool > emplaceAt( std::size_t i, const Key& key, Args&& ...args ) {
+      if ( m_used[ i ] )
+         return { &m_slots[ i ], false };
+      m_slots[ i ] = value_type( key, Value( std::forward< Args >( args )... ) );
+      m_used[ i ] = true;
+      return { &m_slots[ i ], true };
+   }
+
+   value_type m_slots[ Count ];
+   bool m_used[ Count ] = {};
+   FlatHashBackend< Key, Value > m_fallback;
+};
+
+/**
+ * Backend для Count типов, зарегистрированных REGISTER_TYPE:
+ * StorageTraits< CType, DenseTypeIds< TYPE_COUNT( Tag ) >::Backend >.
+ */
+template< std::size_t Count >
+struct DenseTypeIds {
+   template< typename Key, typename Value >
+   using Backend = DenseIdBackend< Key, Value, Count >;
+};
+
+/**
+ * Свойства хранилища реестра: тип хранимого объекта и выбранная реализация.
+ * Специализация TypeStorage наследуется от StorageTraits, чтобы сменить хранилище одной строкой.
+ */
+template< typename Type, template< typename, typename > class Backend = MapBackend >
+struct StorageTraits {
+   using Storage = Backend< int, std::shared_ptr< Type > >;
+   static Storage& instance() {
+      static Storage st;
+      return st;
+   }
+};
+
+/**
+ * Эпохи для отложенного освобождения памяти (epoch-based reclamation).
+ * Читатель на время доступа к разделяемым данным открывает Guard, запоминая текущую эпоху.
+ * Писатель, исключив объект из структуры, помечает его новой эпохой и освобождает объект,
+ * только когда все активные читатели вошли в более позднюю эпоху.
+ * Записи потоков выровнены по кеш-линии, поэтому читатели не конкурируют между собой.
+ * Запись не освобождается, после завершения потока ее занимает следующий поток.
+ */
+class EpochDomain {
+   struct alignas( 64 ) Slot {
+      std::atomic< uint64_t > epoch{ 0 };
+      std::atomic< bool > owned{ false };
+      Slot* next = nullptr;
+      unsigned depth = 0;
+   };
+
+   struct Owner {
+      Slot* slot;
+      Owner() : slot( EpochDomain::instance().acquire() ) {}
+      ~Owner() { slot->owned.store( false, std::memory_order_release ); }
+   };
+
+public:
+   static EpochDomain& instance() {
+      static EpochDomain domain;
+      return domain;
+   }
+
+   /**
+    * Область чтения. Допускает вложенность в пределах одного потока.
+    */
+   class Guard {
+   public:
+      Guard() : m_slot( current() ) {
+         if ( m_slot->depth++ == 0 )
+            m_slot->epoch.store( instance().m_epoch.load( std::memory_order_seq_cst ), std::memory_order_seq_cst );
+      }
+
+      ~Guard() {
+         if ( --m_slot->depth == 0 )
+            m_slot->epoch.store( 0, std::memory_order_release );
+      }
+
+      Guard( const Guard& ) = delete;
+      Guard& operator=( const Guard& ) = delete;
+
+   private:
+      Slot* m_slot;
+   };
+
+   /**
+    * Возвращает метку для объекта, который только что исключен из структуры данных.
+    */
+   uint64_t retire() {
+      return m_epoch.fetch_add( 1, std::memory_order_seq_cst );
+   }
+
+   /**
+    * Объект с меткой tag можно освободить, если метка меньше возвращаемого значения.
+    */
+   uint64_t safeEpoch() const {
+      uint64_t result = m_epoch.load( std::memory_order_seq_cst );
+      for ( Slot* slot = m_head.load( std::memory_order_acquire ); slot; slot = slot->next ) {
+         uint64_t epoch = slot->epoch.load( std::memory_order_seq_cst );
+         if ( epoch != 0 && epoch < result )
+            result = epoch;
+      }
+      return result;
+   }
+
+private:
+   EpochDomain() = default;
+
+   static Slot* current() {
+      thread_local Owner owner;
+      return owner.slot;
+   }
+
+   Slot* acquire() {
+      for ( Slot* slot = m_head.load( std::memory_order_acquire ); slot; slot = slot->next ) {
+         bool owned = false;
+         if ( slot->owned.compare_exchange_strong( owned, true ) )
+            return slot;
+      }
+      // --- operator new в C++14 не учитывает alignas( 64 ), память выделяется с выравниванием явно
+      void* memory = nullptr;
+      if ( posix_memalign( &memory, alignof( Slot ), sizeof( Slot ) ) != 0 )
+         throw std::bad_alloc();
+      Slot* slot = new ( memory ) Slot;
+      slot->owned.store( true );
+      slot->next = m_head.load( std::memory_order_relaxed );
+      while ( !m_head.compare_exchange_weak( slot->next, slot, std::memory_order_release ) );
+      return slot;
+   }
+
+   std::atomic< uint64_t > m_epoch{ 1 };
+   std::atomic< Slot* > m_head{ nullptr };
+};
+
+/**
+ * Потокобезопасное хранилище реестра для многоядерного сервера.
+ * Чтение не берет блокировок: таблица шарда и ее ячейки публикуются атомарно (RCU),
+ * а память защищается эпохами EpochDomain. Писатели сериализуются мьютексом своего шарда.
+ * Объекты не переконструируются на месте: замена публикует новую запись, старая запись
+ * освобождается после выхода всех читателей, а сам объект живет, пока на него есть shared_ptr.
+ */
+template< typename Key, typename Value >
+class ConcurrentBackend {
+   static constexpr std::size_t ShardBits = 6;
+   static constexpr std::size_t ShardCount = std::size_t( 1 ) << ShardBits;
+
+   struct Entry {
+      Key key;
+      Value value;
+   };
+
+   struct Table {
+      std::size_t mask;
+      std::size_t size = 0;
+      std::unique_ptr< std::atomic< Entry* >[] > slots;
+
+      explicit Table( std::size_t capacity ) : mask( capacity - 1 ), slots( new std::atomic< Entry* >[ capacity ] ) {
+         for ( std::size_t i = 0; i < capacity; ++i )
+            slots[ i ].store( nullptr, std::memory_order_relaxed );
+      }
+   };
+
+   struct alignas( 64 ) Shard {
+      std::atomic< Table* > table{ nullptr };
+      std::mutex mutex;
+      std::vector< std::pair< uint64_t, Entry* > > retiredEntries;
+      std::vector< std::pair< uint64_t, Table* > > retiredTables;
+   };
+
+public:
+   using key_type = Key;
+   using mapped_type = Value;
+   static constexpr bool concurrent = true;
+
+   ConcurrentBackend() = default;
+   ConcurrentBackend( const ConcurrentBackend& ) = delete;
+   ConcurrentBackend& operator=( const ConcurrentBackend& ) = delete;
+
+   ~ConcurrentBackend() {
+      for ( Shard& shard : m_shards ) {
+         if ( Table* table = shard.table.load() ) {
+            for ( std::size_t i = 0; i <= table->mask; ++i )
+               delete table->slots[ i ].load();
+            delete table;
+         }
+         reclaim( shard, uint64_t( -1 ) );
+      }
+   }
+
+   /**
+    * Поиск без блокировок. Возвращает пустое значение, если ключ не найден.
+    */
+   Value find( const Key& key ) const {
+      Value result;
+      visit( key, [&result]( const Value& value ) { result = value; } );
+      return result;
+   }
+
+   /**
+    * Вызывает visitor для значения ключа внутри области чтения, не копируя значение.
+    * Для горячих объектов это избавляет читателей от конкуренции за счетчик ссылок shared_ptr.
+    */
+   template< typename Visitor >
+   bool visit( const Key& key, Visitor&& visitor ) const {
+      EpochDomain::Guard guard;
+      uint64_t h = hash( key );
+      const Shard& shard = m_shards[ h >> ( 64 - ShardBits ) ];
+      Table* table = shard.table.load( std::memory_order_acquire );
+      if ( !table )
+         return false;
+      for ( std::size_t i = h & table->mask; ; i = ( i + 1 ) & table->mask ) {
+         Entry* entry = table->slots[ i ].load( std::memory_order_acquire );
+         if ( !entry )
+            return false;
+         if ( entry->key == key ) {
+            visitor( static_cast< const Value& >( entry->value ) );
+            return true;
+         }
+      }
+   }
+
+   /**
+    * Вставляет значение, если ключ еще не занят. Возвращает значение, оказавшееся в хранилище.
+    */
+   Value emplace( const Key& key, Value value ) {
+      return publish( key, std::move( value ), []( const Value& current ) { return !current; } );
+   }
+
+   /**
+    * Заменяет значение ключа, если predicate( текущее значение ) истинен.
+    * Отсутствующему ключу соответствует пустое значение.
+    */
+   template< typename Predicate >
+   Value replace( const Key& key, Value value, Predicate predicate ) {
+      return publish( key, std::move( value ), predicate );
+   }
+
+   Value replace( const Key& key, Value value ) {
+      return publish( key, std::move( value ), []( const Value& ) { return true; } );
+   }
+
+private:
+   static uint64_t hash( const Key& key ) {
+      uint64_t h = uint64_t( key ) * 0x9E3779B97F4A7C15ull;
+      return h ^ ( h >> 29 );
+   }
+
+   template< typename Predicate >
+   Value publish( const Key& key, Value value, Predicate predicate ) {
+      uint64_t h = hash( key );
+      Shard& shard = m_shards[ h >> ( 64 - ShardBits ) ];
+      std::lock_guard< std::mutex > lock( shard.mutex );
+
+      Table* table = shard.table.load( std::memory_order_relaxed );
+      if ( !table || ( table->size + 1 ) * 2 > table->mask + 1 )
+         table = grow( shard, table );
+
+      std::size_t i = h & table->mask;
+      for ( ; Entry* entry = table->slots[ i ].load( std::memory_order_relaxed ); i = ( i + 1 ) & table->mask ) {
+         if ( entry->key != key )
+            continue;
+         if ( !predicate( entry->value ) )
+            return entry->value;
+         Entry* next = new Entry{ key, std::move( value ) };
+         table->slots[ i ].store( next, std::memory_order_release );
+         shard.retiredEntries.emplace_back( EpochDomain::instance().retire(), entry );
+         reclaim( shard, EpochDomain::instance().safeEpoch() );
+         return next->value;
+      }
+
+      if ( !predicate( Value{} ) )
+         return Value{};
+      Entry* entry = new Entry{ key, std::move( value ) };
+      table->slots[ i ].store( entry, std::memory_order_release );
+      ++table->size;
+      return entry->value;
+   }
+
+   Table* grow( Shard& shard, Table* table ) {
+      Table* next = new Table( table ? ( table->mask + 1 ) * 2 : 16 );
+      if ( table ) {
+         for ( std::size_t j = 0; j <= table->mask; ++j ) {
+            Entry* entry = table->slots[ j ].load( std::memory_order_relaxed );
+            if ( !entry )
+               continue;
+            std::size_t i = hash( entry->key ) & next->mask;
+            while ( next->slots[ i ].load( std::memory_order_relaxed ) )
+               i = ( i + 1 ) & next->mask;
+            next->slots[ i ].store( entry, std::memory_order_relaxed );
+         }
+         next->size = table->size;
+      }
+      shard.table.store( next, std::memory_order_release );
+      if ( table )
+         shard.retiredTables.emplace_back( EpochDomain::instance().retire(), table );
+      return next;
+   }
+
+   static void reclaim( Shard& shard, uint64_t safe ) {
+      auto entries = std::partition( shard.retiredEntries.begin(), shard.retiredEntries.end(),
+            [safe]( const std::pair< uint64_t, Entry* >& r ) { return r.first >= safe; } );
+      std::for_each( entries, shard.retiredEntries.end(), []( const std::pair< uint64_t, Entry* >& r ) { delete r.second; } );
+      shard.retiredEntries.erase( entries, shard.retiredEntries.end() );
+
+      auto tables = std::partition( shard.retiredTables.begin(), shard.retiredTables.end(),
+            [safe]( const std::pair< uint64_t, Table* >& r ) { return r.first >= safe; } );
+      std::for_each( tables, shard.retiredTables.end(), []( const std::pair< uint64_t, Table* >& r ) { delete r.second; } );
+      shard.retiredTables.erase( tables, shard.retiredTables.end() );
+   }
+
+   Shard m_shards[ ShardCount ];
+};
+
+/**
+ * Пул блоков одного размера, нарезанных из крупных непрерывных слабов.
+ * Освобожденные блоки складываются в интрузивный список и переиспользуются первыми,
+ * поэтому объекты одного типа лежат плотно и обходятся почти последовательно по памяти.
+ */
+template< typename Type >
+class SlabPool {
+   union Block {
+      Block* next;
+      alignas( Type ) unsigned char storage[ sizeof( Type ) ];
+   };
+
+   static constexpr std::size_t SlabBlocks = std::max< std::size_t >( 64, ( 64 << 10 ) / sizeof( Block ) );
+
+public:
+   /**
+    * Пул намеренно не разрушается: статические хранилища реестра могут освобождать
+    * свои объекты позже, чем отработали бы деструкторы статических пулов.
+    */
+   static SlabPool& instance() {
+      static SlabPool* pool = new SlabPool;
+      return *pool;
+   }
+
+   void* allocate() {
+      std::lock_guard< std::mutex > lock( m_mutex );
+      if ( m_free ) {
+         Block* block = m_free;
+         m_free = block->next;
+         return block;
+      }
+      if ( m_slabs.empty() || m_used == SlabBlocks ) {
+         m_slabs.push_back( new Block[ SlabBlocks ] );
+         m_used = 0;
+      }
+      return &m_slabs.back()[ m_used++ ];
+   }
+
+   void deallocate( void* ptr ) {
+      std::lock_guard< std::mutex > lock( m_mutex );
+      Block* block = static_cast< Block* >( ptr );
+      block->next = m_free;
+      m_free = block;
+   }
+
+   std::size_t capacity() const {
+      return m_slabs.size() * SlabBlocks * sizeof( Block );
+   }
+
+private:
+   SlabPool() = default;
+
+   std::mutex m_mutex;
+   std::vector< Block* > m_slabs;
+   std::size_t m_used = 0;
+   Block* m_free = nullptr;
+};
+
+/**
+ * Аллокатор для std::allocate_shared. Контейнер shared_ptr перепривязывает его к типу
+ * своего управляющего блока, так что объект и счетчики ссылок занимают один блок пула.
+ */
+template< typename Type >
+struct SlabAllocator {
+   using value_type = Type;
+
+   SlabAllocator() = default;
+   template< typename Other >
+   SlabAllocator( const SlabAllocator< Other >& ) {}
+
+   Type* allocate( std::size_t n ) {
+      if ( n != 1 )
+         return static_cast< Type* >( ::operator new( n * sizeof( Type ) ) );
+      return static_cast< Type* >( SlabPool< Type >::instance().allocate() );
+   }
+
+   void deallocate( Type* ptr, std::size_t n ) {
+      if ( n != 1 )
+         ::operator delete( ptr );
+      else
+         SlabPool< Type >::instance().deallocate( ptr );
+   }
+
+   template< typename Other >
+   bool operator==( const SlabAllocator< Other >& ) const { return true; }
+   template< typename Other >
+   bool operator!=( const SlabAllocator< Other >& ) const { return false; }
+};
+
+/**
+ * Создает объект реестра в пуле одним выделением памяти вместо двух (new Type и управляющий блок).
+ * Агрегаты без подходящего конструктора инициализируются фигурными скобками и перемещаются.
+ */
+template< class Type, typename ...Args >
+static auto makeTypePtr( Args&& ...args ) ->
+      typename std::enable_if< std::is_constructible< Type, Args... >::value, std::shared_ptr< Type > >::type {
+   return std::allocate_shared< Type >( SlabAllocator< Type >(), std::forward< Args >( args )... );
+}
+
+template< class Type, typename ...Args >
+static auto makeTypePtr( Args&& ...args ) ->
+      typename std::enable_if< !std::is_constructible< Type, Args... >::value, std::shared_ptr< Type > >::type {
+   return std::allocate_shared< Type >( SlabAllocator< Type >(), Type{ std::forward< Args >( args )... } );
+}
+
+/**
+ * Признак потокобезопасного хранилища, для него getTypePtr заменяет объекты вместо переконструирования.
+ */
+template< typename Storage, typename = void >
+struct IsConcurrentStorage : std::false_type {};
+
+template< typename Storage >
+struct IsConcurrentStorage< Storage, decltype( void( Storage::concurrent ) ) > :
+      std::integral_constant< bool, Storage::concurrent > {};
+
+template< class Type, bool Concurrent >
+using TypePtr = typename std::enable_if<
+      IsConcurrentStorage< typename TypeStorage< Type >::Storage >::value == Concurrent,
+      typename TypeStorage< Type >::Storage::mapped_type >::type;
+
 /**
  *
  */
 template< class Type, typename ...Args >
-static auto getTypePtr( int id, Args&& ...args ) -> typename TypeStorage< Type >::Storage::mapped_type {
+static auto getTypePtr( int id, Args&& ...args ) -> TypePtr< Type, false > {
 
-   auto it = TypeStorage< Type >::instance().emplace( id, nullptr );
+   // --- конструктор Type может рекурсивно вызвать getTypePtr и перестроить открытое хранилище,
+   // --- поэтому итератор не переживает конструирование и элемент ищется повторно
+   auto& storage = TypeStorage< Type >::instance();
+   auto it = storage.emplace( id, nullptr );
    if ( it.second && sizeof...( args ) > 0 ) {
       std::cout << "...1" << std::endl;
-      it.first->second.reset( new Type{ id, std::forward< Args >( args )... } );
+      typename TypeStorage< Type >::Storage::mapped_type ptr( makeTypePtr< Type >( id, std::forward< Args >( args )... ) );
+      return storage.find( id )->second = std::move( ptr );
    }
    else if ( it.second ) {
      std::cout << "...2" << std::endl;
-     it.first->second.reset( new Type{} );
+     typename TypeStorage< Type >::Storage::mapped_type ptr( makeTypePtr< Type >() );
+     return storage.find( id )->second = std::move( ptr );
    }
    else if ( sizeof...( args ) > 0 ) {
       std::cout << "...3" << std::endl;
-      it.first->second->~Type();
-      new ( it.first->second.get() ) Type{ id, std::forward< Args >( args )... };
+      auto ptr = it.first->second;
+      ptr->~Type();
+      new ( ptr.get() ) Type{ id, std::forward< Args >( args )... };
+      return ptr;
    }
    else {
       std::cout << "...4" << std::endl;
@@ -58,20 +934,38 @@ static auto getTypePtr( int id, Args&& ...args ) -> typename TypeStorage< Type >
    return it.first->second;
 }
 
+/**
+ * Вставка по идентификатору типа. Хранилища с совершенным хешированием получают
+ * идентификатор как параметр шаблона и обходятся одним индексированием.
+ */
+template< class Type, typename Storage >
+static auto emplaceType( Storage& storage, int ) -> decltype( storage.template emplace< Type::typeId() >( nullptr ) ) {
+   return storage.template emplace< Type::typeId() >( nullptr );
+}
+
+template< class Type, typename Storage >
+static auto emplaceType( Storage& storage, long ) -> decltype( storage.emplace( Type::typeId(), nullptr ) ) {
+   return storage.emplace( Type::typeId(), nullptr );
+}
+
 template< class Type >
-static auto getTypePtr() -> typename TypeStorage< Type >::Storage::mapped_type {
+static auto getTypePtr() -> TypePtr< Type, false > {
 
    auto id = Type::typeId();
-   auto it = TypeStorage< Type >::instance().emplace( id, nullptr );
+   auto& storage = TypeStorage< Type >::instance();
+   auto it = emplaceType< Type >( storage, 0 );
    if ( it.second ) {
       std::cout << "...5" << std::endl;
-      it.first->second.reset( new Type{} );
+      typename TypeStorage< Type >::Storage::mapped_type ptr( makeTypePtr< Type >() );
+      return storage.find( id )->second = std::move( ptr );
    }
    else if ( it.first->second->id != id ) {
       std::cout << "...6" << std::endl;
-      Type* ptr = static_cast< Type* >( it.first->second.get() );
+      auto holder = it.first->second;
+      Type* ptr = static_cast< Type* >( holder.get() );
       ptr->~Type();
       new ( ptr ) Type{};
+      return holder;
    }
    else {
       std::cout << "...7" << std::endl;
@@ -79,6 +973,38 @@ static auto getTypePtr() -> typename TypeStorage< Type >::Storage::mapped_type {
    return it.first->second;
 }
 
+/**
+ * Потокобезопасные варианты для ConcurrentBackend.
+ * Вместо разрушения и повторного конструирования на месте публикуется новый объект,
+ * поэтому параллельные владельцы shared_ptr продолжают видеть согласованный старый объект.
+ */
+template< class Type, typename ...Args >
+static auto getTypePtr( int id, Args&& ...args ) -> TypePtr< Type, true > {
+
+   auto& storage = TypeStorage< Type >::instance();
+   if ( sizeof...( args ) > 0 )
+      return storage.replace( id, makeTypePtr< Type >( id, std::forward< Args >( args )... ) );
+
+   if ( auto ptr = storage.find( id ) )
+      return ptr;
+   return storage.emplace( id, makeTypePtr< Type >() );
+}
+
+template< class Type >
+static auto getTypePtr() -> TypePtr< Type, true > {
+
+   auto id = Type::typeId();
+   auto& storage = TypeStorage< Type >::instance();
+   auto ptr = storage.find( id );
+   if ( ptr && ptr->id == id )
+      return ptr;
+
+   // --- объект заменяется, только если за время конструирования его не заменил другой поток
+   return storage.replace( id, makeTypePtr< Type >(), [id]( const decltype( ptr )& current ) {
+      return !current || current->id != id;
+   } );
+}
+
 /**
  *
  */
@@ -87,30 +1013,76 @@ struct CType {
    TestData data;
    std::vector< std::weak_ptr< CType > > array;
 
-   void print() {
-      std::cout << "print: " << id << " " << data << "{";
-      std::for_each( array.begin(), array.end(), []( const std::weak_ptr< CType >& ct ) { 
-         std::cout << "\n   "; ct.lock()->print(); } );
-      std::cout << "}" << std::endl;
+   /**
+    * Печать графа без рекурсии: вывод собирается в один буфер и пишется в поток одним вызовом.
+    * Узел, уже находящийся на текущем пути, печатается как ссылка, чтобы не зациклиться.
+    */
+   void print() const {
+      std::ostringstream os;
+      std::vector< std::pair< const CType*, std::size_t > > path{ { this, 0 } };
+      std::unordered_set< const CType* > onPath{ this };
+      os << "print: " << id << " " << data << "{";
+
+      while ( !path.empty() ) {
+         auto& frame = path.back();
+         if ( frame.second == frame.first->array.size() ) {
+            os << "}\n";
+            onPath.erase( frame.first );
+            path.pop_back();
+            continue;
+         }
+
+         auto child = frame.first->array[ frame.second++ ].lock();
+         if ( !child )
+            continue;
+         os << "\n   print: " << child->id << " " << child->data << "{";
+         if ( !onPath.insert( child.get() ).second ) {
+            os << "...}\n";
+            continue;
+         }
+         path.emplace_back( child.get(), 0 );
+      }
+      std::cout << os.str() << std::flush;
    }
-};
 
-template<>
-struct TypeStorage< CType > {
-   using Storage = std::map< int, std::shared_ptr< CType > >;
-   static Storage& instance() {
-      static Storage st;
-      return st;
+   /**
+    * Итеративный обход графа слабых ссылок в глубину, начиная с этого узла.
+    * Каждый достижимый узел посещается ровно один раз, циклы и истекшие ссылки пропускаются.
+    * Сигнатура посетителя: void( const CType& node, std::size_t depth ).
+    */
+   template< typename Visitor >
+   void traverse( Visitor&& visitor ) const {
+      std::vector< std::pair< const CType*, std::size_t > > stack{ { this, 0 } };
+      std::unordered_set< const CType* > visited{ this };
+      std::vector< std::shared_ptr< CType > > alive;
+
+      while ( !stack.empty() ) {
+         auto node = stack.back();
+         stack.pop_back();
+         visitor( *node.first, node.second );
+
+         // --- дочерние узлы кладутся в обратном порядке, чтобы обход шел слева направо
+         for ( auto it = node.first->array.rbegin(); it != node.first->array.rend(); ++it ) {
+            auto child = it->lock();
+            if ( child && visited.insert( child.get() ).second ) {
+               stack.emplace_back( child.get(), node.second + 1 );
+               alive.push_back( std::move( child ) );
+            }
+         }
+      }
    }
 };
 
+template<>
+struct TypeStorage< CType >;
+
 /**
  *
  */
 namespace N1 {
 struct CTypeImpl100 : public CType {
    using Storage = TypeStorage< CType >;
-   static int typeId() { return 100; }
+   static constexpr int typeId() { return 100; }
    CTypeImpl100();
 };
 } // N3
@@ -118,15 +1090,283 @@ struct CTypeImpl100 : public CType {
 namespace N2 {
 struct CTypeImpl1000 : public CType {
    using Storage = TypeStorage< CType >;
-   static int typeId() { return 1000; }
+   static constexpr int typeId() { return 1000; }
    CTypeImpl1000();
 };
 } // N2
 
+template<>
+struct TypeStorage< CType > : StorageTraits< CType,
+      RegisteredTypes< N1::CTypeImpl100, N2::CTypeImpl1000 >::Backend > {};
+
 N1::CTypeImpl100::CTypeImpl100() : CType{ typeId(), typeId() } {
    array.push_back( getTypePtr< N2::CTypeImpl1000 >() ); }
 N2::CTypeImpl1000::CTypeImpl1000() : CType{ typeId(), typeId() } {}
 
+/**
+ * Реализации CType с плотными идентификаторами REGISTER_TYPE: typeId() равен TypeId< DenseCTypes, Type >,
+ * и хранилище DenseCTypes является массивом на TYPE_COUNT( DenseCTypes ) ячеек.
+ * Тег регистрации служит и ключом TypeStorage, поэтому реестр не пересекается с TypeStorage< CType >.
+ */
+struct DenseCTypes {};
+
+namespace N3 {
+struct CTypeDense0;
+struct CTypeDense1;
+} // N3
+
+REGISTER_TYPE( DenseCTypes, N3::CTypeDense0 )
+REGISTER_TYPE( DenseCTypes, N3::CTypeDense1 )
+
+template<>
+struct TypeStorage< DenseCTypes > : StorageTraits< CType, DenseTypeIds< TYPE_COUNT( DenseCTypes ) >::Backend > {};
+
+namespace N3 {
+struct CTypeDense0 : public CType {
+   using Storage = TypeStorage< DenseCTypes >;
+   static constexpr int typeId() { return int( TypeId< DenseCTypes, CTypeDense0 >::value ); }
+   CTypeDense0() : CType{ typeId(), typeId() } {}
+};
+
+struct CTypeDense1 : public CType {
+   using Storage = TypeStorage< DenseCTypes >;
+   static constexpr int typeId() { return int( TypeId< DenseCTypes, CTypeDense1 >::value ); }
+   CTypeDense1() : CType{ typeId(), typeId() } {
+      array.push_back( getTypePtr< CTypeDense0 >() ); }
+};
+} // N3
+
+/**
+ * Бинарный снимок графа CType в одном непрерывном буфере:
+ * заголовок, массив узлов и массив ребер (индексы узлов). Снимок не содержит указателей,
+ * поэтому файл можно отобразить в память через mmap и читать без разбора.
+ */
+struct SnapshotHeader {
+   char magic[ 8 ];
+   uint32_t version;
+   uint32_t nodeCount;
+   uint64_t edgeCount;
+};
+
+struct SnapshotNode {
+   int32_t id;
+   int32_t data;
+   uint64_t firstEdge;
+   uint32_t edgeCount;
+   uint32_t reserved;
+};
+
+static constexpr char SnapshotMagic[ 8 ] = "CTYPESN";
+static constexpr uint32_t SnapshotVersion = 1;
+
+/**
+ * Сериализует граф, достижимый из roots, в один буфер.
+ */
+inline std::vector< char > snapshotGraph( const std::vector< std::shared_ptr< CType > >& roots ) {
+   std::vector< const CType* > nodes;
+   std::unordered_map< const CType*, uint32_t > index;
+   for ( const auto& root : roots ) {
+      if ( !root || index.count( root.get() ) )
+         continue;
+      root->traverse( [&]( const CType& node, std::size_t ) {
+         if ( index.emplace( &node, uint32_t( nodes.size() ) ).second )
+            nodes.push_back( &node );
+      } );
+   }
+
+   std::vector< uint32_t > edges;
+   std::vector< SnapshotNode > records( nodes.size() );
+   for ( std::size_t i = 0; i < nodes.size(); ++i ) {
+      records[ i ] = { nodes[ i ]->id, nodes[ i ]->data.i, edges.size(), 0, 0 };
+      for ( const auto& link : nodes[ i ]->array ) {
+         auto it = index.find( link.lock().get() );
+         if ( it != index.end() ) {
+            edges.push_back( it->second );
+            ++records[ i ].edgeCount;
+         }
+      }
+   }
+
+   SnapshotHeader header{};
+   std::memcpy( header.magic, SnapshotMagic, sizeof( header.magic ) );
+   header.version = SnapshotVersion;
+   header.nodeCount = uint32_t( records.size() );
+   header.edgeCount = edges.size();
+
+   std::vector< char > buffer( sizeof( header ) + records.size() * sizeof( SnapshotNode ) + edges.size() * sizeof( uint32_t ) );
+   char* out = buffer.data();
+   std::memcpy( out, &header, sizeof( header ) );
+   out += sizeof( header );
+   std::memcpy( out, records.data(), records.size() * sizeof( SnapshotNode ) );
+   out += records.size() * sizeof( SnapshotNode );
+   std::memcpy( out, edges.data(), edges.size() * sizeof( uint32_t ) );
+   return buffer;
+}
+
+/**
+ * Снимок, отображенный в память только для чтения. Узлы и ребра читаются прямо из файла.
+ */
+class SnapshotView {
+public:
+   explicit SnapshotView( const char* path ) {
+      int fd = open( path, O_RDONLY | O_CLOEXEC );
+      if ( fd == -1 )
+         return;
+      struct stat st;
+      if ( fstat( fd, &st ) == 0 && std::size_t( st.st_size ) >= sizeof( SnapshotHeader ) ) {
+         void* data = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+         if ( data != MAP_FAILED ) {
+            m_data = static_cast< const char* >( data );
+            m_size = st.st_size;
+         }
+      }
+      close( fd );
+      if ( m_data && !valid() ) {
+         munmap( const_cast< char* >( m_data ), m_size );
+         m_data = nullptr;
+      }
+   }
+
+   ~SnapshotView() {
+      if ( m_data )
+         munmap( const_cast< char* >( m_data ), m_size );
+   }
+
+   SnapshotView( const SnapshotView& ) = delete;
+   SnapshotView& operator=( const SnapshotView& ) = delete;
+
+   bool isOpen() const { return m_data != nullptr; }
+   const SnapshotHeader& header() const { return *reinterpret_cast< const SnapshotHeader* >( m_data ); }
+   const SnapshotNode* nodes() const { return reinterpret_cast< const SnapshotNode* >( m_data + sizeof( SnapshotHeader ) ); }
+   const uint32_t* edges() const { return reinterpret_cast< const uint32_t* >( nodes() + header().nodeCount ); }
+
+private:
+   /**
+    * Файл приходит извне, поэтому кроме заголовка проверяются все диапазоны ребер и индексы узлов:
+    * warmStart индексирует ими массивы без дополнительных проверок.
+    */
+   bool valid() const {
+      const SnapshotHeader& h = header();
+      if ( std::memcmp( h.magic, SnapshotMagic, sizeof( h.magic ) ) != 0 || h.version != SnapshotVersion )
+         return false;
+      // --- размеры сверяются без переполнения: сначала ограничение сверху, затем точное равенство
+      const std::size_t payload = m_size - sizeof( SnapshotHeader );
+      if ( h.nodeCount > payload / sizeof( SnapshotNode ) ||
+            h.edgeCount > ( payload - h.nodeCount * sizeof( SnapshotNode ) ) / sizeof( uint32_t ) ||
+            payload != h.nodeCount * sizeof( SnapshotNode ) + h.edgeCount * sizeof( uint32_t ) )
+         return false;
+
+      const SnapshotNode* nodeList = nodes();
+      for ( uint32_t i = 0; i < h.nodeCount; ++i ) {
+         if ( nodeList[ i ].edgeCount > h.edgeCount || nodeList[ i ].firstEdge > h.edgeCount - nodeList[ i ].edgeCount )
+            return false;
+      }
+      const uint32_t* edgeList = edges();
+      for ( uint64_t e = 0; e < h.edgeCount; ++e ) {
+         if ( edgeList[ e ] >= h.nodeCount )
+            return false;
+      }
+      return true;
+   }
+
+   const char* m_data = nullptr;
+   std::size_t m_size = 0;
+};
+
+/**
+ * Сохраняет снимок в файл, который потом открывается через SnapshotView.
+ */
+inline bool saveSnapshot( const char* path, const std::vector< char >& buffer ) {
+   int fd = open( path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644 );
+   if ( fd == -1 )
+      return false;
+   std::size_t written = 0;
+   while ( written < buffer.size() ) {
+      ssize_t n = write( fd, buffer.data() + written, buffer.size() - written );
+      if ( n <= 0 )
+         break;
+      written += n;
+   }
+   close( fd );
+   return written == buffer.size();
+}
+
+/**
+ * Теплый старт реестра из снимка: объекты создаются как CType с сохраненными полями
+ * без вызова конструкторов реализаций, связи восстанавливаются по индексам ребер.
+ * Уже зарегистрированные идентификаторы не перезаписываются.
+ * Возвращает восстановленные объекты в порядке узлов снимка.
+ */
+inline std::vector< std::shared_ptr< CType > > warmStart( const SnapshotView& view ) {
+   std::vector< std::shared_ptr< CType > > objects;
+   if ( !view.isOpen() )
+      return objects;
+
+   const SnapshotNode* nodes = view.nodes();
+   const uint32_t* edges = view.edges();
+   auto& storage = TypeStorage< CType >::instance();
+   objects.reserve( view.header().nodeCount );
+   for ( uint32_t i = 0; i < view.header().nodeCount; ++i ) {
+      auto it = storage.emplace( nodes[ i ].id, nullptr );
+      if ( it.second )
+         it.first->second = makeTypePtr< CType >( nodes[ i ].id, TestData{ nodes[ i ].data } );
+      objects.push_back( it.first->second );
+   }
+
+   for ( uint32_t i = 0; i < view.header().nodeCount; ++i ) {
+      auto& array = objects[ i ]->array;
+      if ( !array.empty() )
+         continue;
+      array.reserve( nodes[ i ].edgeCount );
+      for ( uint32_t e = 0; e < nodes[ i ].edgeCount; ++e )
+         array.push_back( objects[ edges[ nodes[ i ].firstEdge + e ] ] );
+   }
+   return objects;
+}
+
+/**
+ * Совершенный хеш для Count случайных идентификаторов: все зарегистрированные ищутся,
+ * вставка по известному при компиляции Id идет в таблицу, незарегистрированный Id - в резервную.
+ */
+template< std::size_t Count >
+bool testPerfectHash() {
+   struct Registered { static constexpr int typeId() { return randomTypeId( Count / 2 ); } };
+   struct Unregistered { static constexpr int typeId() { return randomTypeId( Count ); } };
+
+   typename RandomIdsBackend< std::make_index_sequence< Count > >::type storage;
+   for ( std::size_t i = 0; i < Count; ++i ) {
+      if ( !storage.emplace( randomTypeId( i ), std::make_shared< int >( int( i ) ) ).second )
+         return false;
+   }
+   for ( std::size_t i = 0; i < Count; ++i ) {
+      auto it = storage.find( randomTypeId( i ) );
+      if ( it == storage.end() || *it->second != int( i ) )
+         return false;
+   }
+
+   auto registered = emplaceType< Registered >( storage, 0 );
+   auto unregistered = emplaceType< Unregistered >( storage, 0 );
+   return !registered.second && *registered.first->second == int( Count / 2 ) &&
+         unregistered.second && storage.find( Unregistered::typeId() ) == unregistered.first;
+}
+
+/**
+ * Плотные идентификаторы REGISTER_TYPE: зарегистрированные типы вставляются по индексу массива,
+ * emplace< Id >() для идентификатора вне [ 0, TYPE_COUNT ) исключается и уходит в резервную таблицу.
+ */
+inline bool testDenseTypeIds() {
+   static_assert( N3::CTypeDense0::typeId() == 0 && N3::CTypeDense1::typeId() == 1, "" );
+   struct Unregistered { static constexpr int typeId() { return 1000; } };
+
+   auto first = getTypePtr< N3::CTypeDense1 >();
+   auto again = getTypePtr< N3::CTypeDense1 >();
+   auto& storage = TypeStorage< DenseCTypes >::instance();
+   auto unregistered = emplaceType< Unregistered >( storage, 0 );
+   return first == again && first->id == N3::CTypeDense1::typeId() &&
+         storage.find( N3::CTypeDense0::typeId() ) != storage.end() && !first->array.empty() &&
+         unregistered.second && storage.find( Unregistered::typeId() ) == unregistered.first;
+}
+
 template< typename T >
 struct type_deleter {
    void operator ()( T* p) { 
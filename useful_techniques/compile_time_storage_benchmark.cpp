@@ -0,0 +1,245 @@
+#include <iostream>
+#include <random>
+#include <numeric>
+#include <atomic>
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+
+#include <benchmark/benchmark.h>
+
+#include "compile_time_storage.h"
+
+/**
+ * Счетчик выделений памяти для сравнения числа аллокаций на объект.
+ * Заменен полный набор глобальных operator new/delete, включая формы для массивов,
+ * nothrow и выровненные, чтобы ни одно выделение не ушло мимо счетчика.
+ */
+static std::atomic< std::size_t > allocations{ 0 };
+
+static void* countedAlloc( std::size_t size, std::size_t alignment = 0 ) noexcept {
+   allocations.fetch_add( 1, std::memory_order_relaxed );
+   if ( size == 0 )
+      size = 1;
+   if ( alignment <= alignof( std::max_align_t ) )
+      return std::malloc( size );
+   void* ptr = nullptr;
+   return posix_memalign( &ptr, alignment, size ) == 0 ? ptr : nullptr;
+}
+
+static void* countedAllocOrThrow( std::size_t size, std::size_t alignment = 0 ) {
+   if ( void* ptr = countedAlloc( size, alignment ) )
+      return ptr;
+   throw std::bad_alloc();
+}
+
+void* operator new( std::size_t size ) { return countedAllocOrThrow( size ); }
+void* operator new[]( std::size_t size ) { return countedAllocOrThrow( size ); }
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept { return countedAlloc( size ); }
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept { return countedAlloc( size ); }
+
+void operator delete( void* ptr ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr ) noexcept { std::free( ptr ); }
+void operator delete( void* ptr, std::size_t ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr, std::size_t ) noexcept { std::free( ptr ); }
+void operator delete( void* ptr, const std::nothrow_t& ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr, const std::nothrow_t& ) noexcept { std::free( ptr ); }
+
+#ifdef __cpp_aligned_new
+void* operator new( std::size_t size, std::align_val_t alignment ) {
+   return countedAllocOrThrow( size, std::size_t( alignment ) );
+}
+void* operator new[]( std::size_t size, std::align_val_t alignment ) {
+   return countedAllocOrThrow( size, std::size_t( alignment ) );
+}
+void* operator new( std::size_t size, std::align_val_t alignment, const std::nothrow_t& ) noexcept {
+   return countedAlloc( size, std::size_t( alignment ) );
+}
+void* operator new[]( std::size_t size, std::align_val_t alignment, const std::nothrow_t& ) noexcept {
+   return countedAlloc( size, std::size_t( alignment ) );
+}
+
+void operator delete( void* ptr, std::align_val_t ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr, std::align_val_t ) noexcept { std::free( ptr ); }
+void operator delete( void* ptr, std::size_t, std::align_val_t ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr, std::size_t, std::align_val_t ) noexcept { std::free( ptr ); }
+void operator delete( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept { std::free( ptr ); }
+void operator delete[]( void* ptr, std::align_val_t, const std::nothrow_t& ) noexcept { std::free( ptr ); }
+#endif
+
+/**
+ * Объект реестра без отладочной печати в конструкторах.
+ */
+struct Node {
+   int id = 0;
+   double payload[ 7 ] = {};
+};
+
+/**
+ * Сравнение хранилищ реестра объектов на вставку и поиск по идентификатору.
+ * Аргумент бенчмарка задает число зарегистрированных объектов.
+ */
+template< template< typename, typename > class Backend >
+class StorageBenchmark : public benchmark::Fixture {
+public:
+   using Storage = Backend< int, std::shared_ptr< CType > >;
+
+   void SetUp( const benchmark::State& state ) override {
+      ids.resize( state.range( 0 ) );
+      std::iota( ids.begin(), ids.end(), 0 );
+      std::shuffle( ids.begin(), ids.end(), std::mt19937( 42 ) );
+   }
+
+   void TearDown( const benchmark::State& ) override {
+      ids.clear();
+      ids.shrink_to_fit();
+   }
+
+protected:
+   std::vector< int > ids;
+};
+
+template< typename Key, typename Value >
+using DenseBackend = DenseVectorBackend< Key, Value >;
+
+template< typename Storage >
+static void insertLoop( benchmark::State& state, const std::vector< int >& ids ) {
+   for ( auto _ : state ) {
+      Storage storage;
+      for ( int id : ids )
+         storage.emplace( id, nullptr );
+      benchmark::DoNotOptimize( storage );
+   }
+   state.SetItemsProcessed( state.iterations() * ids.size() );
+}
+
+template< typename Storage >
+static void findLoop( benchmark::State& state, const std::vector< int >& ids ) {
+   Storage storage;
+   for ( int id : ids )
+      storage.emplace( id, nullptr );
+   for ( auto _ : state ) {
+      for ( int id : ids )
+         benchmark::DoNotOptimize( storage.find( id )->second );
+   }
+   state.SetItemsProcessed( state.iterations() * ids.size() );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, MapInsert, MapBackend ) ( benchmark::State& state ) {
+   insertLoop< Storage >( state, ids );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, FlatInsert, FlatHashBackend ) ( benchmark::State& state ) {
+   insertLoop< Storage >( state, ids );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, DenseInsert, DenseBackend ) ( benchmark::State& state ) {
+   insertLoop< Storage >( state, ids );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, MapFind, MapBackend ) ( benchmark::State& state ) {
+   findLoop< Storage >( state, ids );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, FlatFind, FlatHashBackend ) ( benchmark::State& state ) {
+   findLoop< Storage >( state, ids );
+}
+
+BENCHMARK_TEMPLATE_DEFINE_F( StorageBenchmark, DenseFind, DenseBackend ) ( benchmark::State& state ) {
+   findLoop< Storage >( state, ids );
+}
+
+/**
+ * Масштабирование чтения потокобезопасного хранилища по числу потоков.
+ */
+static void ConcurrentFind( benchmark::State& state ) {
+   static ConcurrentBackend< int, std::shared_ptr< Node > > storage;
+   static const int count = 100000;
+   if ( state.thread_index() == 0 && !storage.find( 0 ) ) {
+      for ( int id = 0; id < count; ++id )
+         storage.emplace( id, std::make_shared< Node >() );
+   }
+
+   int id = state.thread_index();
+   for ( auto _ : state ) {
+      storage.visit( id, []( const std::shared_ptr< Node >& node ) { benchmark::DoNotOptimize( node->id ); } );
+      id = ( id + 7919 ) % count;
+   }
+   state.SetItemsProcessed( state.iterations() );
+}
+
+/**
+ * Создание объектов через new + shared_ptr и через пул с allocate_shared.
+ */
+struct HeapFactory {
+   static std::shared_ptr< Node > make() { return std::shared_ptr< Node >( new Node{} ); }
+};
+
+struct PoolFactory {
+   static std::shared_ptr< Node > make() { return makeTypePtr< Node >(); }
+};
+
+template< typename Factory >
+static void Create( benchmark::State& state ) {
+   std::vector< std::shared_ptr< Node > > nodes;
+   nodes.reserve( state.range( 0 ) );
+   std::size_t count = 0;
+   for ( auto _ : state ) {
+      std::size_t before = allocations.load();
+      for ( int64_t i = 0; i < state.range( 0 ); ++i )
+         nodes.push_back( Factory::make() );
+      count += allocations.load() - before;
+
+      state.PauseTiming();
+      nodes.clear();
+      state.ResumeTiming();
+   }
+   state.counters[ "allocs_per_object" ] = double( count ) / ( state.iterations() * state.range( 0 ) );
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+
+/**
+ * Обход всех объектов типа. Между созданием объектов куча засоряется посторонними
+ * выделениями, как это происходит в живом процессе.
+ */
+template< typename Factory >
+static void Iterate( benchmark::State& state ) {
+   std::mt19937 random( 42 );
+   std::vector< std::shared_ptr< Node > > nodes;
+   std::vector< std::unique_ptr< char[] > > noise;
+   for ( int64_t i = 0; i < state.range( 0 ); ++i ) {
+      nodes.push_back( Factory::make() );
+      nodes.back()->id = int( i );
+      noise.emplace_back( new char[ 16 + random() % 256 ] );
+   }
+
+   for ( auto _ : state ) {
+      int64_t sum = 0;
+      for ( const auto& node : nodes )
+         sum += node->id;
+      benchmark::DoNotOptimize( sum );
+   }
+   state.SetItemsProcessed( state.iterations() * state.range( 0 ) );
+}
+
+#define TEST_RANGE RangeMultiplier( 10 )->Range( 1000, 10000000 )->Unit( benchmark::kMillisecond )
+BENCHMARK_REGISTER_F( StorageBenchmark, MapInsert )->TEST_RANGE;
+BENCHMARK_REGISTER_F( StorageBenchmark, FlatInsert )->TEST_RANGE;
+BENCHMARK_REGISTER_F( StorageBenchmark, DenseInsert )->TEST_RANGE;
+BENCHMARK_REGISTER_F( StorageBenchmark, MapFind )->TEST_RANGE;
+BENCHMARK_REGISTER_F( StorageBenchmark, FlatFind )->TEST_RANGE;
+BENCHMARK_REGISTER_F( StorageBenchmark, DenseFind )->TEST_RANGE;
+BENCHMARK( ConcurrentFind )->ThreadRange( 1, 64 )->UseRealTime();
+BENCHMARK_TEMPLATE( Create, HeapFactory )->RangeMultiplier( 10 )->Range( 1000, 1000000 );
+BENCHMARK_TEMPLATE( Create, PoolFactory )->RangeMultiplier( 10 )->Range( 1000, 1000000 );
+BENCHMARK_TEMPLATE( Iterate, HeapFactory )->RangeMultiplier( 10 )->Range( 1000, 1000000 );
+BENCHMARK_TEMPLATE( Iterate, PoolFactory )->RangeMultiplier( 10 )->Range( 1000, 1000000 );
+
+int main( int argc, char** argv ) {
+   benchmark::Initialize( &argc, argv );
+   if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+      return 1;
+
+   benchmark::RunSpecifiedBenchmarks();
+   return 0;
+}
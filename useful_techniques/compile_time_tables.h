@@ -0,0 +1,223 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ratio>
+#include <utility>
+
+/**
+ * Генератор таблиц при компиляции без состояния между вызовами.
+ * Generator - литеральный тип с value_type и
+ *     constexpr value_type operator()( size_t index, const value_type* table ) const,
+ * где table содержит уже вычисленные элементы [ 0, index ), что позволяет задавать как функцию индекса,
+ * так и рекуррентное соотношение. Таблица заполняется одним циклом и копируется в std::array:
+ *
+ *     ConstexprTable< FactorialGenerator<>, 21 >::values[ 20 ]   // --- 20!
+ *
+ * Таблица - статический член шаблона, поэтому в программе одна копия на пару Generator, N.
+ * Генераторы ниже укладываются для 64K элементов в лимиты GCC по умолчанию
+ * (-fconstexpr-loop-limit=262144, -fconstexpr-ops-limit=2^25).
+ */
+template< typename T, size_t N >
+struct TableBuffer {
+   T values[ N ];
+};
+
+/* В C++14 запись через operator[] у std::array не constexpr, поэтому заполняется обычный массив */
+template< typename T, size_t N, typename Generator >
+constexpr TableBuffer< T, N > fillTable( const Generator& generator ) {
+   TableBuffer< T, N > buffer{};
+   for ( size_t index = 0; index < N; ++index )
+      buffer.values[ index ] = generator( index, buffer.values );
+   return buffer;
+}
+
+template< typename T, size_t N, size_t... I >
+constexpr std::array< T, N > toArray( const TableBuffer< T, N >& buffer, std::index_sequence< I... > ) {
+   return {{ buffer.values[ I ]... }};
+}
+
+template< typename Generator, size_t N >
+struct ConstexprTable {
+   using value_type = typename Generator::value_type;
+   static constexpr size_t size = N;
+   static constexpr std::array< value_type, N > values =
+         toArray( fillTable< value_type, N >( Generator() ), std::make_index_sequence< N >() );
+};
+
+template< typename Generator, size_t N >
+constexpr std::array< typename Generator::value_type, N > ConstexprTable< Generator, N >::values;
+
+/**
+ * n! по рекурренте n! = n * ( n - 1 )!. Для uint64_t без переполнения до 20!, для double - до 170!.
+ */
+template< typename T = uint64_t >
+struct FactorialGenerator {
+   using value_type = T;
+
+   constexpr T operator()( size_t index, const T* table ) const {
+      return index == 0 ? T( 1 ) : table[ index - 1 ] * T( index );
+   }
+};
+
+template< size_t N, typename T = uint64_t >
+using Factorials = ConstexprTable< FactorialGenerator< T >, N >;
+
+/**
+ * Треугольник Паскаля, уложенный по строкам: C( n, k ) лежит по индексу binomialIndex( n, k ).
+ */
+constexpr size_t binomialIndex( size_t n, size_t k ) {
+   return n * ( n + 1 ) / 2 + k;
+}
+
+constexpr size_t integerSqrt( size_t value ) {
+   size_t root = value, next = ( value + 1 ) / 2;
+   while ( next < root ) {
+      root = next;
+      next = ( root + value / root ) / 2;
+   }
+   return root;
+}
+
+template< typename T = uint64_t >
+struct BinomialGenerator {
+   using value_type = T;
+
+   constexpr T operator()( size_t index, const T* table ) const {
+      size_t n = ( integerSqrt( 8 * index + 1 ) - 1 ) / 2;
+      const size_t k = index - binomialIndex( n, 0 );
+      return k == 0 || k == n ? T( 1 ) : table[ binomialIndex( n - 1, k - 1 ) ] + table[ binomialIndex( n - 1, k ) ];
+   }
+};
+
+/* Строки 0..Rows-1; для uint64_t без переполнения до Rows = 68 */
+template< size_t Rows, typename T = uint64_t >
+struct Binomials : ConstexprTable< BinomialGenerator< T >, Rows * ( Rows + 1 ) / 2 > {
+   static constexpr T get( size_t n, size_t k ) {
+      return Binomials::values[ binomialIndex( n, k ) ];
+   }
+};
+
+/**
+ * exp, sin и cos для constexpr-вычислений: приведение аргумента с разбиением константы
+ * на старшую и младшую части и ряд Тейлора на отрезке приведения. Погрешность - единицы ulp.
+ */
+constexpr double constexprExp( double x ) {
+   constexpr double ln2High = 6.93147180369123816490e-01;
+   constexpr double ln2Low = 1.90821492927058770002e-10;
+   long n = long( x / ( ln2High + ln2Low ) + ( x < 0 ? -0.5 : 0.5 ) );
+   const double r = ( x - double( n ) * ln2High ) - double( n ) * ln2Low;
+
+   double term = 1, sum = 1;
+   for ( int k = 1; k < 16; ++k ) {
+      term *= r / k;
+      sum += term;
+   }
+   for ( ; n > 0; --n )
+      sum *= 2;
+   for ( ; n < 0; ++n )
+      sum /= 2;
+   return sum;
+}
+
+/* sin( r ) или cos( r ) при cosine = true, |r| <= pi / 4 */
+constexpr double reducedSinCos( double r, bool cosine ) {
+   double term = cosine ? 1 : r, sum = term;
+   for ( int k = cosine ? 1 : 2; k < 24; k += 2 ) {
+      term *= -r * r / ( k * ( k + 1 ) );
+      sum += term;
+   }
+   return sum;
+}
+
+constexpr double constexprSinCos( double x, bool cosine ) {
+   constexpr double halfPiHigh = 1.57079632673412561417e+00;
+   constexpr double halfPiLow = 6.07710050650619224932e-11;
+   const long n = long( x / ( halfPiHigh + halfPiLow ) + ( x < 0 ? -0.5 : 0.5 ) );
+   const double r = ( x - double( n ) * halfPiHigh ) - double( n ) * halfPiLow;
+   const unsigned quadrant = ( unsigned( n & 3 ) + ( cosine ? 1u : 0u ) ) & 3u;
+   switch ( quadrant ) {
+   case 0: return reducedSinCos( r, false );
+   case 1: return reducedSinCos( r, true );
+   case 2: return -reducedSinCos( r, false );
+   default: return -reducedSinCos( r, true );
+   }
+}
+
+constexpr double constexprSin( double x ) {
+   return constexprSinCos( x, false );
+}
+
+constexpr double constexprCos( double x ) {
+   return constexprSinCos( x, true );
+}
+
+/**
+ * Прямое вычисление стоит сотни операций, для 64K элементов это выходит за лимит,
+ * поэтому внутри блока из TableBlock элементов используется рекуррента, а в начале блока
+ * значение вычисляется заново, чтобы погрешность рекурренты не накапливалась по всей таблице.
+ * Множители рекуррент вычисляются один раз в конструкторе генератора.
+ */
+constexpr size_t TableBlock = 16;
+
+/**
+ * exp( Start + index * Step ), Start и Step задаются std::ratio: e[ i ] = e[ i - 1 ] * exp( Step ).
+ */
+template< typename Start, typename Step >
+struct ExpGenerator {
+   using value_type = double;
+
+   constexpr ExpGenerator() : m_factor( constexprExp( argument( 1 ) - argument( 0 ) ) ) {}
+
+   constexpr double operator()( size_t index, const double* table ) const {
+      return index % TableBlock == 0 ? constexprExp( argument( index ) ) : table[ index - 1 ] * m_factor;
+   }
+
+private:
+   static constexpr double argument( size_t index ) {
+      return double( Start::num ) / Start::den + double( index ) * Step::num / Step::den;
+   }
+
+   double m_factor;
+};
+
+/**
+ * Один период sin или cos: значение для index равно sin( 2 * pi * index / Period ).
+ * Рекуррента Чебышева f[ i ] = 2 * cos( h ) * f[ i - 1 ] - f[ i - 2 ] верна для обеих функций.
+ * Индекс по модулю Period получается маской, если Period - степень двойки.
+ */
+template< size_t Period, bool Cosine = false >
+struct HarmonicGenerator {
+   using value_type = double;
+
+   constexpr HarmonicGenerator() : m_factor( 2 * constexprCos( angle( 1 ) ) ) {}
+
+   constexpr double operator()( size_t index, const double* table ) const {
+      return index % TableBlock < 2 ? constexprSinCos( angle( index ), Cosine )
+            : m_factor * table[ index - 1 ] - table[ index - 2 ];
+   }
+
+private:
+   static constexpr double angle( size_t index ) {
+      return 6.28318530717958647692 * double( index ) / double( Period );
+   }
+
+   double m_factor;
+};
+
+template< size_t Period >
+using SinTable = ConstexprTable< HarmonicGenerator< Period, false >, Period >;
+
+template< size_t Period >
+using CosTable = ConstexprTable< HarmonicGenerator< Period, true >, Period >;
+
+void testTables() {
+   static_assert( Factorials< 21 >::values[ 5 ] == 120, "5!" );
+   static_assert( Factorials< 21 >::values[ 20 ] == 2432902008176640000ull, "20!" );
+   static_assert( Binomials< 68 >::get( 10, 3 ) == 120, "C( 10, 3 )" );
+   static_assert( Binomials< 68 >::get( 67, 33 ) == 14226520737620288370ull, "C( 67, 33 )" );
+   static_assert( SinTable< 8 >::values[ 1 ] == constexprSin( 0.78539816339744830962 ), "sin" );
+   static_assert( ( SinTable< 8 >::values[ 2 ] - 1.0 ) * ( SinTable< 8 >::values[ 2 ] - 1.0 ) < 1e-30, "sin" );
+   static_assert( ( CosTable< 8 >::values[ 4 ] + 1.0 ) * ( CosTable< 8 >::values[ 4 ] + 1.0 ) < 1e-30, "cos" );
+   static_assert( ( constexprExp( 1.0 ) - 2.71828182845904523536 ) * ( constexprExp( 1.0 ) - 2.71828182845904523536 ) < 1e-30, "exp" );
+}
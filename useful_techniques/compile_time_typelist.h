@@ -1,6 +1,10 @@
 #pragma once
 #include <type_traits>
 #include <tuple>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+#include <new>
 
 /**
  * 
@@ -104,6 +108,326 @@ struct Walk< std::tuple<> > {
    using value = Empty;
 };
 
+/**
+ * Списки типов в виде пакета параметров std::tuple< Types... >.
+ * В отличие от Entry, глубина инстанцирования не зависит от длины списка:
+ * PackSize и PackPush вычисляются за одно инстанцирование,
+ * PackItem выбирает тип разрешением перегрузки среди баз PackIndexed< I, Type >.
+ */
+template< typename Tuple >
+struct PackSize;
+
+template< typename... Types >
+struct PackSize< std::tuple< Types... > > : std::integral_constant< size_t, sizeof...( Types ) > {};
+
+template< size_t I, typename Type >
+struct PackIndexed {
+   using value = Type;
+};
+
+template< typename Sequence, typename... Types >
+struct PackIndexer;
+
+template< size_t... I, typename... Types >
+struct PackIndexer< std::index_sequence< I... >, Types... > : PackIndexed< I, Types >... {};
+
+template< size_t I, typename Type >
+PackIndexed< I, Type > packSelect( const PackIndexed< I, Type >& );
+
+template< typename Tuple, size_t I, bool = ( I < PackSize< Tuple >::value ) >
+struct PackItem {
+   using value = Empty;
+};
+
+template< typename... Types, size_t I >
+struct PackItem< std::tuple< Types... >, I, true > {
+   using value = typename decltype( packSelect< I >(
+         std::declval< PackIndexer< std::index_sequence_for< Types... >, Types... > >() ) )::value;
+};
+
+template< typename Tuple, typename T >
+struct PackPush;
+
+template< typename... Types, typename T >
+struct PackPush< std::tuple< Types... >, T > {
+   using value = std::tuple< Types..., T >;
+};
+
+/**
+ * Преобразование между Entry и пакетом. Список Entry разбирается по 8 элементов за шаг,
+ * поэтому глубина инстанцирования в 8 раз меньше длины списка, а пакеты не копируются на каждом шаге.
+ */
+template< typename List, typename... Types >
+struct ToPackImpl {
+   using value = typename ToPackImpl< typename List::next, Types..., typename List::value >::value;
+};
+
+template< typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7,
+      typename Next, typename... Types >
+struct ToPackImpl< Entry< T0, Entry< T1, Entry< T2, Entry< T3, Entry< T4, Entry< T5, Entry< T6, Entry< T7, Next > > > > > > > >,
+      Types... > {
+   using value = typename ToPackImpl< Next, Types..., T0, T1, T2, T3, T4, T5, T6, T7 >::value;
+};
+
+template< typename... Types >
+struct ToPackImpl< Empty, Types... > {
+   using value = std::tuple< Types... >;
+};
+
+template< typename List >
+using ToPack = typename ToPackImpl< List >::value;
+
+template< typename Tuple >
+struct ToListImpl;
+
+template< typename T0, typename T1, typename T2, typename T3, typename T4, typename T5, typename T6, typename T7,
+      typename... Types >
+struct ToListImpl< std::tuple< T0, T1, T2, T3, T4, T5, T6, T7, Types... > > {
+   using value = Entry< T0, Entry< T1, Entry< T2, Entry< T3, Entry< T4, Entry< T5, Entry< T6, Entry< T7,
+         typename ToListImpl< std::tuple< Types... > >::value > > > > > > > >;
+};
+
+template< typename Type, typename... Types >
+struct ToListImpl< std::tuple< Type, Types... > > {
+   using value = Entry< Type, typename ToListImpl< std::tuple< Types... > >::value >;
+};
+
+template<>
+struct ToListImpl< std::tuple<> > {
+   using value = Empty;
+};
+
+template< typename Tuple >
+using ToList = typename ToListImpl< Tuple >::value;
+
+/**
+ * Номер типа T в пакете, или размер пакета, если такого типа нет.
+ */
+constexpr size_t packFind( const bool* same, size_t size ) {
+   size_t index = 0;
+   while ( index < size && !same[ index ] )
+      ++index;
+   return index;
+}
+
+template< typename Tuple, typename T >
+struct PackIndex;
+
+template< typename... Types, typename T >
+struct PackIndex< std::tuple< Types... >, T > {
+   static constexpr bool same[] = { std::is_same< T, Types >::value..., false };
+   static constexpr size_t value = packFind( same, sizeof...( Types ) );
+};
+
+template< typename... Types, typename T >
+constexpr bool PackIndex< std::tuple< Types... >, T >::same[];
+
+/**
+ * Вызов обработчика по номеру типа, прочитанному во время выполнения.
+ * Для каждого типа пакета генерируется функция-переходник, указатели на них
+ * собираются в таблицу при компиляции, поэтому вызов - одно косвенное обращение по индексу.
+ * Для пакетов до InlineLimit типов вместо таблицы встраивается цепочка сравнений.
+ *
+ *     // --- visitor( PackTag< T >(), args... ) для типа с номером index
+ *     Dispatch< List >::call( index, visitor, args... );
+ *
+ *     // --- visitor( *static_cast< T* >( data ) ) для объекта типа с номером index
+ *     Dispatch< List >::apply( index, data, visitor );
+ *
+ * Все обработчики должны возвращать тот же тип, что и обработчик первого типа пакета.
+ * Номер типа должен быть меньше размера пакета.
+ */
+template< typename T >
+struct PackTag {
+   using value = T;
+};
+
+template< typename Tuple >
+struct Dispatch;
+
+template< typename... Types >
+struct Dispatch< std::tuple< Types... > > {
+   using First = typename PackItem< std::tuple< Types... >, 0 >::value;
+
+   template< typename Visitor, typename... Args >
+   static decltype( auto ) call( size_t index, Visitor&& visitor, Args&&... args ) {
+      using Result = decltype( visitor( PackTag< First >(), std::forward< Args >( args )... ) );
+      using Handler = Result( * )( Visitor&, Args&&... );
+      static constexpr Handler table[] = { &callType< Types, Result, Visitor, Args... >... };
+      return table[ index ]( visitor, std::forward< Args >( args )... );
+   }
+
+   template< typename Data, typename Visitor >
+   static decltype( auto ) apply( size_t index, Data* data, Visitor&& visitor ) {
+      static_assert( std::is_void< Data >::value, "data must be void* or const void*" );
+      using Result = decltype( visitor( std::declval< Object< First, Data >& >() ) );
+      return applyIndex< Result >( index, data, visitor, std::integral_constant< bool, ( sizeof...( Types ) <= InlineLimit ) >() );
+   }
+
+private:
+   template< typename T, typename Result, typename Visitor, typename... Args >
+   static Result callType( Visitor& visitor, Args&&... args ) {
+      return visitor( PackTag< T >(), std::forward< Args >( args )... );
+   }
+
+   /* До стольких типов сравнения по очереди встраиваются и обгоняют косвенный вызов */
+   static constexpr size_t InlineLimit = 4;
+
+   template< typename T, typename Data >
+   using Object = typename std::conditional< std::is_const< Data >::value, const T, T >::type;
+
+   template< typename T, typename Result, typename Data, typename Visitor >
+   static Result applyType( Data* data, Visitor& visitor ) {
+      return visitor( *static_cast< Object< T, Data >* >( data ) );
+   }
+
+   template< typename Result, typename Data, typename Visitor >
+   static Result applyIndex( size_t index, Data* data, Visitor& visitor, std::false_type ) {
+      using Handler = Result( * )( Data*, Visitor& );
+      static constexpr Handler table[] = { &applyType< Types, Result, Data, Visitor >... };
+      return table[ index ]( data, visitor );
+   }
+
+   template< typename Result, typename Data, typename Visitor >
+   static Result applyIndex( size_t index, Data* data, Visitor& visitor, std::true_type ) {
+      return applyChain< Result, 0, Types... >( index, data, visitor );
+   }
+
+   template< typename Result, size_t I, typename T, typename Data, typename Visitor >
+   static Result applyChain( size_t, Data* data, Visitor& visitor ) {
+      return applyType< T, Result >( data, visitor );
+   }
+
+   template< typename Result, size_t I, typename T, typename Next, typename... Rest, typename Data, typename Visitor >
+   static Result applyChain( size_t index, Data* data, Visitor& visitor ) {
+      if ( index == I )
+         return applyType< T, Result >( data, visitor );
+      return applyChain< Result, I + 1, Next, Rest... >( index, data, visitor );
+   }
+};
+
+/**
+ * Размеченное объединение типов пакета.
+ * Размер хранилища равен наибольшему из типов, номер типа хранится в наименьшем подходящем целом.
+ * Копирование, перемещение, уничтожение и visit выполняются через таблицы Dispatch.
+ * Копировать можно только объединения, все типы которых копируемы.
+ *
+ *     Union< std::tuple< int, std::string > > value( std::string( "text" ) );
+ *     value.visit( []( auto& item ) { std::cout << item; } );
+ *
+ * Для списков Entry пакет получается через ToPack< List >.
+ */
+template< typename Tuple >
+class Union;
+
+template< typename... Types >
+class Union< std::tuple< Types... > > {
+public:
+   using List = std::tuple< Types... >;
+   using Index = typename std::conditional< sizeof...( Types ) < UINT8_MAX, uint8_t,
+         typename std::conditional< sizeof...( Types ) < UINT16_MAX, uint16_t, uint32_t >::type >::type;
+   static constexpr size_t npos = sizeof...( Types );
+
+   Union() : m_index( npos ) {}
+
+   template< typename T, typename Type = typename std::decay< T >::type,
+         typename = typename std::enable_if< PackIndex< List, Type >::value != npos >::type >
+   Union( T&& value ) : m_index( npos ) {
+      emplace< Type >( std::forward< T >( value ) );
+   }
+
+   Union( const Union& other ) : m_index( npos ) {
+      if ( !other.empty() )
+         other.visit( [ this ]( const auto& value ) { this->emplace< std::decay_t< decltype( value ) > >( value ); } );
+   }
+
+   Union( Union&& other ) : m_index( npos ) {
+      if ( !other.empty() )
+         other.visit( [ this ]( auto& value ) { this->emplace< std::decay_t< decltype( value ) > >( std::move( value ) ); } );
+   }
+
+   Union& operator=( const Union& other ) {
+      if ( this != &other ) {
+         reset();
+         if ( !other.empty() )
+            other.visit( [ this ]( const auto& value ) { this->emplace< std::decay_t< decltype( value ) > >( value ); } );
+      }
+      return *this;
+   }
+
+   Union& operator=( Union&& other ) {
+      if ( this != &other ) {
+         reset();
+         if ( !other.empty() )
+            other.visit( [ this ]( auto& value ) { this->emplace< std::decay_t< decltype( value ) > >( std::move( value ) ); } );
+      }
+      return *this;
+   }
+
+   ~Union() {
+      reset();
+   }
+
+   template< typename T, typename... Args >
+   T& emplace( Args&&... args ) {
+      static_assert( PackIndex< List, T >::value != npos, "type is not in the union" );
+      reset();
+      T* value = new ( &m_storage ) T( std::forward< Args >( args )... );
+      m_index = Index( PackIndex< List, T >::value );
+      return *value;
+   }
+
+   void reset() {
+      if ( empty() )
+         return;
+      visit( []( auto& value ) {
+         using T = std::decay_t< decltype( value ) >;
+         value.~T();
+      } );
+      m_index = npos;
+   }
+
+   size_t index() const {
+      return m_index;
+   }
+
+   bool empty() const {
+      return m_index == npos;
+   }
+
+   /* Для пустого объединения индекс равен npos, как и PackIndex отсутствующего типа */
+   template< typename T >
+   bool holds() const {
+      static_assert( PackIndex< List, T >::value != npos, "type is not in the union" );
+      return m_index == PackIndex< List, T >::value;
+   }
+
+   template< typename T >
+   T* getIf() {
+      return holds< T >() ? reinterpret_cast< T* >( &m_storage ) : nullptr;
+   }
+
+   template< typename T >
+   const T* getIf() const {
+      return holds< T >() ? reinterpret_cast< const T* >( &m_storage ) : nullptr;
+   }
+
+   /* Объединение не должно быть пустым */
+   template< typename Visitor >
+   decltype( auto ) visit( Visitor&& visitor ) {
+      return Dispatch< List >::apply( m_index, static_cast< void* >( &m_storage ), visitor );
+   }
+
+   template< typename Visitor >
+   decltype( auto ) visit( Visitor&& visitor ) const {
+      return Dispatch< List >::apply( m_index, static_cast< const void* >( &m_storage ), visitor );
+   }
+
+private:
+   typename std::aligned_union< 0, Types... >::type m_storage;
+   Index m_index;
+};
+
 /**
  * 
  */
@@ -127,4 +451,19 @@ void testTypeList() {
    using w3 = typename Walk< t3 >::value;
    using wtest = Entry< bool, Entry< char, Entry< int, Empty > > >;
    static_assert( std::is_same< w3, wtest >::value, "" );
+
+   using p3 = typename PackPush< typename PackPush< typename PackPush< std::tuple<>, bool >::value, char >::value, int >::value;
+   static_assert( std::is_same< p3, ttest >::value, "" );
+   static_assert( PackSize< p3 >::value == Size< ltest >::value, "" );
+   static_assert( std::is_same< typename PackItem< p3, 1 >::value, char >::value, "" );
+   static_assert( std::is_same< typename PackItem< p3, 3 >::value, Empty >::value, "" );
+   static_assert( std::is_same< ToPack< ltest >, ttest >::value, "" );
+   static_assert( std::is_same< ToList< p3 >, ltest >::value, "" );
+
+   using l9 = ToList< std::tuple< int, char, bool, long, short, float, double, void*, unsigned > >;
+   static_assert( Size< l9 >::value == 9, "" );
+   static_assert( std::is_same< ToPack< l9 >, std::tuple< int, char, bool, long, short, float, double, void*, unsigned > >::value, "" );
+
+   static_assert( PackIndex< ttest, int >::value == 2 && PackIndex< ttest, long >::value == 3, "" );
+   static_assert( sizeof( Union< std::tuple< char, short > > ) == 4, "" );
 }
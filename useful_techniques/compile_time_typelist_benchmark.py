@@ -0,0 +1,97 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Замер времени и памяти компиляции списков типов из compile_time_typelist.h.
+
+Для каждого числа типов генерируется единица трансляции:
+    entry   - список Entry, построенный последовательными Push, затем Size и Item последнего типа;
+    pack    - то же самое через PackPush, PackSize и PackItem;
+    convert - преобразование пакета в Entry и обратно через ToList и ToPack.
+
+Пример запуска:
+    python compile_time_typelist_benchmark.py --counts 100 1000 5000 --cxx g++ -- -ftemplate-depth=10000
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def entry_source(count):
+    lines = ['#include "compile_time_typelist.h"', 'template< int N > struct T {};', 'using l0 = Empty;']
+    lines += ['using l%d = typename Push< l%d, T< %d > >::value;' % (i + 1, i, i) for i in range(count)]
+    lines.append('static_assert( Size< l%d >::value == %d, "" );' % (count, count))
+    lines.append('static_assert( std::is_same< typename Item< l%d, %d >::value::value, T< %d > >::value, "" );'
+                 % (count, count - 1, count - 1))
+    lines.append('int main() { return 0; }')
+    return '\n'.join(lines) + '\n'
+
+
+def pack_source(count):
+    lines = ['#include "compile_time_typelist.h"', 'template< int N > struct T {};', 'using p0 = std::tuple<>;']
+    lines += ['using p%d = typename PackPush< p%d, T< %d > >::value;' % (i + 1, i, i) for i in range(count)]
+    lines.append('static_assert( PackSize< p%d >::value == %d, "" );' % (count, count))
+    lines.append('static_assert( std::is_same< typename PackItem< p%d, %d >::value, T< %d > >::value, "" );'
+                 % (count, count - 1, count - 1))
+    lines.append('int main() { return 0; }')
+    return '\n'.join(lines) + '\n'
+
+
+def convert_source(count):
+    types = ', '.join('T< %d >' % i for i in range(count))
+    lines = ['#include "compile_time_typelist.h"', 'template< int N > struct T {};']
+    lines.append('using pack = std::tuple< %s >;' % types)
+    lines.append('static_assert( std::is_same< ToPack< ToList< pack > >, pack >::value, "" );')
+    lines.append('int main() { return 0; }')
+    return '\n'.join(lines) + '\n'
+
+
+SOURCES = {'entry': entry_source, 'pack': pack_source, 'convert': convert_source}
+
+
+def compile_once(cxx, flags, directory, source):
+    path = os.path.join(directory, 'main.cpp')
+    with open(path, 'w') as file:
+        file.write(source)
+
+    command = [cxx, '-std=c++14', '-fsyntax-only', '-I', HERE] + flags + [path]
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = process.stderr.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    if status != 0:
+        errors = [line for line in stderr.decode(errors='replace').splitlines() if 'error' in line]
+        return None, errors[:1]
+    return (elapsed, usage.ru_maxrss / 1024.), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--counts', type=int, nargs='+', default=[100, 1000, 5000])
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'))
+    parser.add_argument('--variants', nargs='+', default=['entry', 'pack', 'convert'])
+    parser.add_argument('flags', nargs='*', help='дополнительные флаги компилятора')
+    args = parser.parse_args()
+
+    print('%-10s %8s %10s %10s' % ('variant', 'count', 'time, s', 'rss, MiB'))
+    for variant in args.variants:
+        for count in args.counts:
+            with tempfile.TemporaryDirectory() as directory:
+                result, errors = compile_once(args.cxx, args.flags, directory, SOURCES[variant](count))
+
+            if result is None:
+                print('%-10s %8d %10s %10s  %s' % (variant, count, 'error', '-', ' / '.join(errors)[:120]))
+            else:
+                print('%-10s %8d %10.2f %10.1f' % (variant, count, result[0], result[1]))
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
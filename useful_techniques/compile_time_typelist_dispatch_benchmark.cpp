@@ -0,0 +1,140 @@
+#include <memory>
+#include <random>
+#include <variant>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "compile_time_typelist.h"
+
+/**
+ * Сравнение вызова обработчика по номеру типа: Union с таблицей Dispatch,
+ * std::variant со std::visit и виртуальный вызов через указатель на базовый класс.
+ * Собирается с -std=c++17 из-за std::variant, сам compile_time_typelist.h требует только C++14.
+ * Типы элементов выбираются случайно, чтобы переход не предсказывался по порядку.
+ */
+static constexpr std::size_t ElementCount = 1 << 12;
+
+struct Base {
+   virtual ~Base() = default;
+   virtual int get() const = 0;
+};
+
+template< std::size_t I >
+struct Alt {
+   static constexpr int factor = int( I ) + 1;
+   int value;
+};
+
+template< std::size_t I >
+struct VirtualAlt : Base {
+   explicit VirtualAlt( int value ) : value( value ) {}
+   int get() const override { return value * Alt< I >::factor; }
+   int value;
+};
+
+template< typename Sequence >
+struct Alternatives;
+
+template< std::size_t... I >
+struct Alternatives< std::index_sequence< I... > > {
+   using List = std::tuple< Alt< I >... >;
+   using Variant = std::variant< Alt< I >... >;
+   using Virtual = std::tuple< VirtualAlt< I >... >;
+};
+
+template< std::size_t N >
+using AltList = Alternatives< std::make_index_sequence< N > >;
+
+struct Handler {
+   template< typename T >
+   int operator()( const T& item ) const { return item.value * T::factor; }
+};
+
+static std::vector< std::size_t > randomIndices( std::size_t count ) {
+   std::mt19937 random( 42 );
+   std::uniform_int_distribution< std::size_t > distribution( 0, count - 1 );
+   std::vector< std::size_t > indices( ElementCount );
+   for ( auto& index : indices )
+      index = distribution( random );
+   return indices;
+}
+
+template< std::size_t N >
+static void UnionVisit( benchmark::State& state ) {
+   using List = typename AltList< N >::List;
+   std::vector< Union< List > > items( ElementCount );
+   int value = 0;
+   for ( std::size_t index : randomIndices( N ) )
+      Dispatch< List >::call( index, [ & ]( auto tag ) {
+         using T = typename decltype( tag )::value;
+         items[ value ].template emplace< T >( T{ value } );
+         ++value;
+      } );
+
+   for ( auto _ : state ) {
+      int sum = 0;
+      for ( const auto& item : items )
+         sum += item.visit( Handler() );
+      benchmark::DoNotOptimize( sum );
+   }
+   state.SetItemsProcessed( state.iterations() * ElementCount );
+}
+
+template< std::size_t N >
+static void VariantVisit( benchmark::State& state ) {
+   using Variant = typename AltList< N >::Variant;
+   std::vector< Variant > items;
+   items.reserve( ElementCount );
+   for ( std::size_t index : randomIndices( N ) )
+      items.push_back( Dispatch< typename AltList< N >::List >::call( index, [ & ]( auto tag ) {
+         using T = typename decltype( tag )::value;
+         return Variant( T{ int( items.size() ) } );
+      } ) );
+
+   for ( auto _ : state ) {
+      int sum = 0;
+      for ( const auto& item : items )
+         sum += std::visit( Handler(), item );
+      benchmark::DoNotOptimize( sum );
+   }
+   state.SetItemsProcessed( state.iterations() * ElementCount );
+}
+
+template< std::size_t N >
+static void VirtualCall( benchmark::State& state ) {
+   std::vector< std::unique_ptr< Base > > items;
+   items.reserve( ElementCount );
+   for ( std::size_t index : randomIndices( N ) )
+      items.push_back( Dispatch< typename AltList< N >::Virtual >::call( index, [ & ]( auto tag ) {
+         using T = typename decltype( tag )::value;
+         return std::unique_ptr< Base >( new T( int( items.size() ) ) );
+      } ) );
+
+   for ( auto _ : state ) {
+      int sum = 0;
+      for ( const auto& item : items )
+         sum += item->get();
+      benchmark::DoNotOptimize( sum );
+   }
+   state.SetItemsProcessed( state.iterations() * ElementCount );
+}
+
+#define DISPATCH_BENCHMARK( N ) \
+   BENCHMARK_TEMPLATE( UnionVisit, N ); \
+   BENCHMARK_TEMPLATE( VariantVisit, N ); \
+   BENCHMARK_TEMPLATE( VirtualCall, N )
+
+DISPATCH_BENCHMARK( 4 );
+DISPATCH_BENCHMARK( 16 );
+DISPATCH_BENCHMARK( 64 );
+DISPATCH_BENCHMARK( 256 );
+
+int main( int argc, char** argv ) {
+   benchmark::Initialize( &argc, argv );
+   if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+      return 1;
+
+   benchmark::RunSpecifiedBenchmarks();
+   return 0;
+}
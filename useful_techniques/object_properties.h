@@ -1,55 +1,549 @@
 #pragma once
 
 #include <utility>
+#include <cstdint>
+#include <algorithm>
+#include <initializer_list>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+#include <atomic>
+#include <thread>
+#include <tuple>
+
+#include "compile_time_registry.h"
+
+/**
+ * Таблица поиска индекса свойства по роли, построенная при компиляции.
+ * Для компактных ролей используется плотный массив role -> index,
+ * для разреженных ролей - хеш-таблица с открытой адресацией и заполнением не более 1/2.
+ * Если роль не найдена, find возвращает Count.
+ */
+template< std::size_t ...Roles >
+class RoleTable {
+public:
+    static constexpr std::size_t Count = sizeof...( Roles );
+
+    static constexpr std::size_t find( std::size_t role ) {
+        if ( Dense )
+            return role < Size ? Table.index[ role ] : Count;
+        for ( std::size_t i = hash( role ); ; i = ( i + 1 ) & ( Size - 1 ) ) {
+            if ( Table.index[ i ] == Count || Table.role[ i ] == role )
+                return Table.index[ i ];
+        }
+    }
+
+private:
+    static constexpr std::size_t roles[ Count + 1 ] = { Roles..., 0 };
+
+    static constexpr std::size_t maxRole() {
+        std::size_t result = 0;
+        for ( std::size_t i = 0; i < Count; ++i )
+            result = roles[ i ] > result ? roles[ i ] : result;
+        return result;
+    }
+
+    static constexpr std::size_t hashSize() {
+        std::size_t size = 2;
+        while ( size < Count * 2 )
+            size *= 2;
+        return size;
+    }
+
+    static constexpr bool Dense = maxRole() < Count * 4 + 64;
+    static constexpr std::size_t Size = Dense ? maxRole() + 1 : hashSize();
+
+    static constexpr std::size_t hash( std::size_t role ) {
+        return std::size_t( ( uint64_t( role ) * 0x9E3779B97F4A7C15ull ) >> 32 ) & ( Size - 1 );
+    }
+
+    struct Layout {
+        std::size_t role[ Size ] = {};
+        std::size_t index[ Size ] = {};
+        bool unique = true;
+    };
+
+    static constexpr Layout layout() {
+        Layout result;
+        for ( std::size_t i = 0; i < Size; ++i )
+            result.index[ i ] = Count;
+        for ( std::size_t j = 0; j < Count; ++j ) {
+            std::size_t i = Dense ? roles[ j ] : hash( roles[ j ] );
+            while ( !Dense && result.index[ i ] != Count && result.role[ i ] != roles[ j ] )
+                i = ( i + 1 ) & ( Size - 1 );
+            result.unique = result.unique && result.index[ i ] == Count;
+            result.role[ i ] = roles[ j ];
+            result.index[ i ] = j;
+        }
+        return result;
+    }
+
+    static constexpr Layout Table = layout();
+    static_assert( Table.unique, "property roles must be unique within a tag" );
+};
+
+template< std::size_t ...Roles >
+constexpr std::size_t RoleTable< Roles... >::roles[];
+
+template< std::size_t ...Roles >
+constexpr typename RoleTable< Roles... >::Layout RoleTable< Roles... >::Table;
+
+/**
+ * Целое без знака в двоичном потоке кодируется группами по 7 бит, младшие группы первыми.
+ */
+inline void writeVarint( std::vector< char >& buffer, uint64_t value ) {
+    while ( value >= 0x80 ) {
+        buffer.push_back( char( value | 0x80 ) );
+        value >>= 7;
+    }
+    buffer.push_back( char( value ) );
+}
+
+inline bool readVarint( const char*& data, const char* end, uint64_t& value ) {
+    value = 0;
+    for ( unsigned shift = 0; data != end && shift < 64; shift += 7 ) {
+        uint8_t byte = uint8_t( *data++ );
+        value |= uint64_t( byte & 0x7F ) << shift;
+        if ( !( byte & 0x80 ) )
+            return true;
+    }
+    return false;
+}
 
 /**
- * Utility stuff.
+ * Кодирование значения свойства в двоичный поток.
+ * Тривиально копируемые значения копируются побайтно, строки и векторы - длиной и элементами.
+ * Для остальных типов значений необходимо объявить собственную специализацию PropertyCodec.
+ * Метод read возвращает false, если данных в потоке недостаточно.
  */
-template< std::size_t Index >
-struct size_t_ : std::integral_constant< std::size_t, Index > {
+template< typename Value, typename = void >
+struct PropertyCodec;
+
+template< typename Value >
+struct PropertyCodec< Value, typename std::enable_if< std::is_trivially_copyable< Value >::value >::type > {
+    static void write( std::vector< char >& buffer, const Value& value ) {
+        const char* data = reinterpret_cast< const char* >( &value );
+        buffer.insert( buffer.end(), data, data + sizeof( Value ) );
+    }
+
+    static bool read( const char*& data, const char* end, Value& value ) {
+        if ( std::size_t( end - data ) < sizeof( Value ) )
+            return false;
+        std::memcpy( &value, data, sizeof( Value ) );
+        data += sizeof( Value );
+        return true;
+    }
+};
+
+template< typename Container >
+struct PropertySequenceCodec {
+    using Item = typename Container::value_type;
+
+    static void write( std::vector< char >& buffer, const Container& value ) {
+        writeVarint( buffer, value.size() );
+        write( buffer, value, std::is_trivially_copyable< Item >() );
+    }
+
+    static bool read( const char*& data, const char* end, Container& value ) {
+        uint64_t size = 0;
+        if ( !readVarint( data, end, size ) )
+            return false;
+        return read( data, end, size, value, std::is_trivially_copyable< Item >() );
+    }
+
+private:
+    static void write( std::vector< char >& buffer, const Container& value, std::true_type ) {
+        const char* data = reinterpret_cast< const char* >( value.data() );
+        buffer.insert( buffer.end(), data, data + value.size() * sizeof( Item ) );
+    }
+
+    static void write( std::vector< char >& buffer, const Container& value, std::false_type ) {
+        for ( const Item& item : value )
+            PropertyCodec< Item >::write( buffer, item );
+    }
+
+    static bool read( const char*& data, const char* end, uint64_t size, Container& value, std::true_type ) {
+        if ( uint64_t( end - data ) / sizeof( Item ) < size )
+            return false;
+        value.resize( std::size_t( size ) );
+        if ( size )
+            std::memcpy( &value[ 0 ], data, std::size_t( size ) * sizeof( Item ) );
+        data += std::size_t( size ) * sizeof( Item );
+        return true;
+    }
+
+    static bool read( const char*& data, const char* end, uint64_t size, Container& value, std::false_type ) {
+        value.clear();
+        for ( uint64_t i = 0; i < size; ++i ) {
+            Item item;
+            if ( !PropertyCodec< Item >::read( data, end, item ) )
+                return false;
+            value.push_back( std::move( item ) );
+        }
+        return true;
+    }
+};
+
+template< typename Char, typename Traits, typename Allocator >
+struct PropertyCodec< std::basic_string< Char, Traits, Allocator > > :
+        PropertySequenceCodec< std::basic_string< Char, Traits, Allocator > > {
+};
+
+template< typename Item, typename Allocator >
+struct PropertyCodec< std::vector< Item, Allocator >, typename std::enable_if< !std::is_same< Item, bool >::value >::type > :
+        PropertySequenceCodec< std::vector< Item, Allocator > > {
 };
 
-template< typename Tag, std::size_t Base, std::size_t Tail >
-constexpr size_t_< Tail > counter_reminder( Tag, size_t_< Base >, size_t_< Tail > ) {
+/**
+ * Флаги изменения свойств объекта - набор бит фиксированного размера внутри объекта.
+ * При объявлении свойства BIND_PROPERTY выдает ему следующий номер бита объекта (по всем тегам),
+ * поэтому набор не выделяет память и не ищет тег во время выполнения.
+ * Операции над тегом используют маску его бит, вычисленную при компиляции.
+ * Число свойств объекта ограничено PROPERTY_MAX_COUNT, превышение не компилируется.
+ * Для политик с seqlock слова флагов атомарные: флаг выставляют писатели из разных потоков,
+ * а take забирает флаги, не теряя выставленных одновременно с ним.
+ */
+#ifndef PROPERTY_MAX_COUNT
+#define PROPERTY_MAX_COUNT 256
+#endif
+
+static_assert( PROPERTY_MAX_COUNT < ( std::size_t( 1 ) << COUNTER_MAX_BITS ), "raise COUNTER_MAX_BITS" );
+
+/**
+ * Номера бит выдает отдельный счетчик, общий для всех тегов объекта.
+ * Его ячейки объявляют функцию-напоминание с собственным именем: GCC просматривает скрытых друзей
+ * одного имени общим списком, и общий с тегами counter_reminder удвоил бы время чтения счетчиков тегов.
+ */
+template< typename Object, std::size_t Value >
+struct property_slot;
+
+template< typename Object, std::size_t Value >
+constexpr size_t_< Value & ( Value - 1 ) > property_slot_reminder( property_slot< Object, Value >* ) {
     return {};
 }
 
+#define PROPERTY_SLOT_READ_BASE( Object, Base, Tail ) \
+property_slot_reminder( static_cast< property_slot< Object, ( Base ) | ( Tail ) >* >( nullptr ) )
+
+#define PROPERTY_SLOT_READ( Object ) \
+COUNTER_CONCAT( COUNTER_READ_, COUNTER_MAX_BITS )( PROPERTY_SLOT_READ_BASE, Object, 0 )
+
+#define PROPERTY_SLOT_INC_FROM( Object, Value ) \
+template<> \
+struct property_slot< Object, ( Value ) + 1 > { \
+    friend constexpr size_t_< ( Value ) + 1 > property_slot_reminder( property_slot* ) { return {}; } \
+};
+
+template< std::size_t Capacity, bool Concurrent = false >
+class PropertyChanges {
+public:
+    static constexpr std::size_t WordCount = ( Capacity + 63 ) / 64;
+
+    struct Mask {
+        uint64_t words[ WordCount ] = {};
+    };
+
+    template< std::size_t ...Slots >
+    static constexpr Mask mask() {
+        const std::size_t slots[] = { Slots..., Capacity };
+        Mask result;
+        for ( std::size_t i = 0; i < sizeof...( Slots ); ++i )
+            result.words[ slots[ i ] / 64 ] |= uint64_t( 1 ) << ( slots[ i ] % 64 );
+        return result;
+    }
+
+    void set( std::size_t slot ) {
+        m_words[ slot / 64 ] |= uint64_t( 1 ) << ( slot % 64 );
+    }
+
+    bool test( std::size_t slot ) const {
+        return m_words[ slot / 64 ] >> ( slot % 64 ) & 1;
+    }
+
+    void setAll( const Mask& mask ) {
+        for ( std::size_t i = 0; i < WordCount; ++i )
+            m_words[ i ] |= mask.words[ i ];
+    }
+
+    void clear( const Mask& mask ) {
+        for ( std::size_t i = 0; i < WordCount; ++i )
+            m_words[ i ] &= ~mask.words[ i ];
+    }
+
+    bool any( const Mask& mask ) const {
+        for ( std::size_t i = 0; i < WordCount; ++i ) {
+            if ( m_words[ i ] & mask.words[ i ] )
+                return true;
+        }
+        return false;
+    }
+
+    /* Сбрасывает флаги маски и возвращает те из них, что были выставлены */
+    Mask take( const Mask& mask ) {
+        Mask result;
+        for ( std::size_t i = 0; i < WordCount; ++i ) {
+            result.words[ i ] = fetchAnd( m_words[ i ], ~mask.words[ i ] ) & mask.words[ i ];
+        }
+        return result;
+    }
+
+    static std::size_t count( const Mask& mask ) {
+        std::size_t result = 0;
+        for ( uint64_t word : mask.words )
+            result += std::size_t( __builtin_popcountll( word ) );
+        return result;
+    }
+
+    /* Перебор выставленных бит за время, пропорциональное их числу */
+    template< typename Visitor >
+    static void visit( const Mask& mask, Visitor&& visitor ) {
+        for ( std::size_t i = 0; i < WordCount; ++i ) {
+            for ( uint64_t word = mask.words[ i ]; word; word &= word - 1 )
+                visitor( i * 64 + std::size_t( __builtin_ctzll( word ) ) );
+        }
+    }
+
+private:
+    using Word = typename std::conditional< Concurrent, std::atomic< uint64_t >, uint64_t >::type;
+
+    static uint64_t fetchAnd( uint64_t& word, uint64_t bits ) {
+        const uint64_t previous = word;
+        word &= bits;
+        return previous;
+    }
+
+    static uint64_t fetchAnd( std::atomic< uint64_t >& word, uint64_t bits ) {
+        return word.fetch_and( bits );
+    }
+
+    Word m_words[ WordCount ] = {};
+};
+
+/**
+ * Значение свойства, которое читатели получают без блокировок (RCU).
+ * Писатель создает новую копию значения, публикует указатель на нее и удаляет прежнюю копию,
+ * когда из нее вышли все читатели. Читатель отмечается в одном из двух счетчиков,
+ * поэтому чтение не ждет писателя, а ожидание писателя ограничено временем уже начатых чтений.
+ * Метод get предназначен для потока писателя, остальные потоки читают значение через read.
+ */
+template< typename Value >
+class SharedValue {
+public:
+    SharedValue() : m_value( new Value() ) {}
+    SharedValue( const Value& value ) : m_value( new Value( value ) ) {}
+    SharedValue( Value&& value ) : m_value( new Value( std::move( value ) ) ) {}
+    SharedValue( const SharedValue& other ) : m_value( new Value( other.get() ) ) {}
+    SharedValue( SharedValue&& other ) : m_value( other.m_value.exchange( new Value() ) ) {}
+    ~SharedValue() { delete m_value.load(); }
+
+    SharedValue& operator=( const SharedValue& other ) {
+        if ( this != &other )
+            publish( new Value( other.get() ) );
+        return *this;
+    }
+
+    SharedValue& operator=( SharedValue&& other ) {
+        if ( this != &other )
+            publish( other.m_value.exchange( new Value() ) );
+        return *this;
+    }
+
+    const Value& get() const {
+        return *m_value.load( std::memory_order_acquire );
+    }
+
+    template< typename Visitor >
+    void read( Visitor&& visitor ) const {
+        const std::size_t phase = m_phase.load() & 1;
+        m_readers[ phase ].fetch_add( 1 );
+        visitor( static_cast< const Value& >( *m_value.load() ) );
+        m_readers[ phase ].fetch_sub( 1 );
+    }
+
+private:
+    /* Каждый из счетчиков должен хотя бы раз обнулиться после замены указателя. */
+    /* Смена фазы перед ожиданием уводит новых читателей в другой счетчик. */
+    void publish( Value* value ) {
+        Value* previous = m_value.exchange( value );
+        const std::size_t phase = m_phase.fetch_add( 1 ) & 1;
+        while ( m_readers[ phase ].load() )
+            std::this_thread::yield();
+        m_phase.fetch_add( 1 );
+        while ( m_readers[ phase ^ 1 ].load() )
+            std::this_thread::yield();
+        delete previous;
+    }
+
+    std::atomic< Value* > m_value;
+    std::atomic< std::size_t > m_phase{ 0 };
+    mutable std::atomic< std::size_t > m_readers[ 2 ] = {};
+};
+
+template< typename Value >
+struct PropertyCodec< SharedValue< Value > > {
+    static void write( std::vector< char >& buffer, const SharedValue< Value >& value ) {
+        PropertyCodec< Value >::write( buffer, value.get() );
+    }
+
+    static bool read( const char*& data, const char* end, SharedValue< Value >& value ) {
+        Value result;
+        if ( !PropertyCodec< Value >::read( data, end, result ) )
+            return false;
+        value = SharedValue< Value >( std::move( result ) );
+        return true;
+    }
+};
+
+/**
+ * Политики синхронизации свойств объекта, выбираются макросом BIND_CONCURRENT_OBJECT.
+ * PropertyNoLock не синхронизирует ничего и используется макросом BIND_OBJECT.
+ * PropertyObjectLock защищает все свойства объекта одним seqlock,
+ * PropertyTagLock - отдельным seqlock для тега (теги распределяются по 8 счетчикам).
+ * Под seqlock писатели сериализуются, а читатель копирует значение и повторяет копирование,
+ * если за это время значение изменилось. Поэтому seqlock применим только к тривиально
+ * копируемым значениям, большие значения следует хранить в SharedValue, которое seqlock не использует.
+ */
+struct PropertyNoLock {
+    static constexpr bool Optimistic = false;
+
+    template< typename Tag > void lock() {}
+    template< typename Tag > void unlock() {}
+
+    template< typename Tag, typename Reader >
+    void read( Reader&& reader ) const {
+        reader();
+    }
+};
+
+class PropertySeqLock {
+public:
+    void lock() {
+        uint32_t sequence = m_sequence.load( std::memory_order_relaxed );
+        while ( ( sequence & 1 ) || !m_sequence.compare_exchange_weak( sequence, sequence + 1, std::memory_order_acquire ) ) {
+            std::this_thread::yield();
+            sequence = m_sequence.load( std::memory_order_relaxed );
+        }
+        std::atomic_thread_fence( std::memory_order_release );
+    }
+
+    void unlock() {
+        m_sequence.store( m_sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+
+    template< typename Reader >
+    void read( Reader&& reader ) const {
+        for ( ;; ) {
+            const uint32_t sequence = m_sequence.load( std::memory_order_acquire );
+            if ( sequence & 1 )
+                continue;
+            reader();
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( m_sequence.load( std::memory_order_relaxed ) == sequence )
+                return;
+        }
+    }
+
+private:
+    std::atomic< uint32_t > m_sequence{ 0 };
+};
+
+struct PropertyObjectLock {
+    static constexpr bool Optimistic = true;
+
+    template< typename Tag > void lock() { m_lock.lock(); }
+    template< typename Tag > void unlock() { m_lock.unlock(); }
+
+    template< typename Tag, typename Reader >
+    void read( Reader&& reader ) const {
+        m_lock.read( reader );
+    }
+
+    PropertySeqLock m_lock;
+};
+
+/* Адрес статической переменной служит уникальным ключом тега во время выполнения */
+template< typename Tag >
+struct PropertyTagKey {
+    static const char value;
+};
+
+template< typename Tag >
+const char PropertyTagKey< Tag >::value = 0;
+
+struct PropertyTagLock {
+    static constexpr bool Optimistic = true;
+
+    template< typename Tag > void lock() { m_locks[ stripe< Tag >() ].lock(); }
+    template< typename Tag > void unlock() { m_locks[ stripe< Tag >() ].unlock(); }
+
+    template< typename Tag, typename Reader >
+    void read( Reader&& reader ) const {
+        m_locks[ stripe< Tag >() ].read( reader );
+    }
+
+    template< typename Tag >
+    static std::size_t stripe() {
+        return std::size_t( reinterpret_cast< uintptr_t >( &PropertyTagKey< Tag >::value ) * 0x9E3779B97F4A7C15ull >> 61 );
+    }
+
+    PropertySeqLock m_locks[ 8 ];
+};
+
 /**
- * Макросы для чтение значения счетчика времени компиляции.
- * Каждый счетчик характеризуется собственным тегом.
- * Максимальное значение счетчика определяется последним значением степени 2.
+ * Захват политики на время записи значения свойства и чтение копии значения.
+ * Значения SharedValue синхронизируются сами и политику не используют.
  */
-#define PACK_ARGS( ... ) __VA_ARGS__
-
-#define COUNTER_READ_BASE( Tag, Base, Tail ) \
-counter_reminder( PACK_ARGS( Tag ){}, size_t_< Base >(), size_t_< Tail >() )
-
-#define COUNTER_READ( Tag ) \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 1, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 2, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 4, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 8, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 16, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 32, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 64, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 128, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 256, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 512, \
-COUNTER_READ_BASE( PACK_ARGS( Tag ), 1024, \
-        0 ) ) ) ) ) ) ) ) ) ) )
-
-#define COUNTER_INC( Tag ) \
-constexpr size_t_< COUNTER_READ( PACK_ARGS( Tag ) ) + 1 > \
-counter_reminder( Tag&&, \
-        size_t_< ( COUNTER_READ( PACK_ARGS( Tag ) ) + 1 ) & ~COUNTER_READ( PACK_ARGS( Tag ) ) >, \
-        size_t_< ( COUNTER_READ( PACK_ARGS( Tag ) ) + 1 ) & COUNTER_READ( PACK_ARGS( Tag ) ) > ) \
-        { return {}; }
+template< typename Policy, typename Tag, typename Value >
+class PropertyWriteGuard {
+public:
+    explicit PropertyWriteGuard( Policy& policy ) : m_policy( policy ) { policy.template lock< Tag >(); }
+    ~PropertyWriteGuard() { m_policy.template unlock< Tag >(); }
+
+private:
+    Policy& m_policy;
+};
+
+template< typename Policy, typename Tag, typename Value >
+class PropertyWriteGuard< Policy, Tag, SharedValue< Value > > {
+public:
+    explicit PropertyWriteGuard( Policy& ) {}
+};
+
+template< typename Policy, typename Tag, typename Value >
+struct PropertyReader {
+    static_assert( !Policy::Optimistic || std::is_trivially_copyable< Value >::value,
+            "seqlock protects only trivially copyable properties, use SharedValue for others" );
+    using Result = Value;
+
+    template< typename Visitor >
+    static void read( const Policy& policy, const Value& value, Visitor&& visitor ) {
+        Value copy;
+        policy.template read< Tag >( [ & ] { copy = value; } );
+        visitor( static_cast< const Value& >( copy ) );
+    }
+};
+
+template< typename Policy, typename Tag, typename Value >
+struct PropertyReader< Policy, Tag, SharedValue< Value > > {
+    using Result = Value;
+
+    template< typename Visitor >
+    static void read( const Policy&, const SharedValue< Value >& value, Visitor&& visitor ) {
+        value.read( visitor );
+    }
+};
+
+template< typename Object, typename ...Tags >
+class PropertyColumns;
 
 /**
  * Макрос объявляет методы для упрощения доступа к свойствам класса.
  * Каждое свойство классифицируется тегом (любой тривиальный тип данных) и уникальной ролью (числовой идентификатор).
  * Для объявления свойства класса необходимо вызвать макрос BIND_PROPERTY (смотреть описание ниже).
  * При изменении свойства может быть вызван метод обработчик, если такой был указан.
+ * Макрос BIND_CONCURRENT_OBJECT дополнительно принимает политику синхронизации (смотреть PropertyNoLock).
  * Примеры использования методов для доступа к свойствам:
  *
  *     // --- получение значения по ссылке
@@ -65,18 +559,47 @@ counter_reminder( Tag&&, \
  * В последнем примере удобно использовать в качестве значения функтор с
  * переопределенными операторами приведения к типу и присваивания для шаблонных параметров.
  * Тогда нет необходимости следить за типом объекта у свойства.
+ *
+ *     // --- пакетное изменение свойств, обработчики вызываются один раз при фиксации
+ *     {
+ *         auto batch = object->batchUpdate();
+ *         object->setProperty< Tag, Role1 >( value1 );
+ *         object->setProperty< Tag, Role2 >( value2 );
+ *     }
+ *
+ *     // --- передача изменившихся свойств тега другому объекту в виде двоичной дельты
+ *     std::vector< char > delta;
+ *     object->writeDelta< Tag >( delta );
+ *     bool state = replica->applyDelta< Tag >( delta.data(), delta.size() );
+ *
+ *     // --- снимок всех свойств тега и восстановление из него
+ *     std::vector< char > checkpoint;
+ *     object->snapshot< Tag >( checkpoint );
+ *     std::size_t used = object->restore< Tag >( checkpoint.data(), checkpoint.size() );
+ *
+ *     // --- чтение из другого потока, согласованное с записью через setProperty
+ *     auto value = object->readProperty< Tag, Role >();
+ *     object->readProperty< Tag, Role >( []( const auto& value ) { ... } );
  */
-#define BIND_OBJECT( Object ) \
+#define BIND_OBJECT( Object ) BIND_CONCURRENT_OBJECT( Object, PropertyNoLock )
+
+#define BIND_CONCURRENT_OBJECT( Object, Policy ) \
 private: \
     template< typename Tag, std::size_t Role > struct PropertyBinding; \
     template< typename Tag, std::size_t Ident > struct PropertyIdentity; \
     template< typename Tag, std::size_t Role > using ObjectType = typename PropertyBinding< Tag, Role >::ObjectType; \
     template< typename Tag, std::size_t Role > using ValueType = typename PropertyBinding< Tag, Role >::ValueType; \
+    using Handler = bool( * )( Object& ); \
+    using Changes = PropertyChanges< PROPERTY_MAX_COUNT, Policy::Optimistic >; \
+    \
+    template< typename, typename... > friend class PropertyColumns; \
     \
     Object( const Object& ) = delete; \
     Object( Object&& ) = delete; \
     \
 public: \
+    using PropertyOwner = Object; \
+    \
     template< typename Tag, std::size_t Role > \
     auto property() const -> const ValueType< Tag, Role >& { \
         auto& that = static_cast< ObjectType< Tag, Role >& >( const_cast< Object& >( *this ) ); \
@@ -92,114 +615,471 @@ public: \
     template< typename Tag, std::size_t Role > \
     void resetProperty() { \
         auto& that = static_cast< ObjectType< Tag, Role >& >( *this ); \
-        PropertyBinding< Tag, Role >::value( that ) = {}; \
+        { \
+            PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+            PropertyBinding< Tag, Role >::value( that ) = {}; \
+            markChanged< Tag, Role >(); \
+        } \
         PropertyBinding< Tag, Role >::notify( that ); \
     } \
     \
     template< typename Tag, std::size_t Role > \
     void setProperty( const ValueType< Tag, Role >& value ) { \
         auto& that = static_cast< ObjectType< Tag, Role >& >( *this ); \
-        PropertyBinding< Tag, Role >::value( that ) = value; \
+        { \
+            PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+            PropertyBinding< Tag, Role >::value( that ) = value; \
+            markChanged< Tag, Role >(); \
+        } \
         PropertyBinding< Tag, Role >::notify( that ); \
     } \
     \
     template< typename Tag, std::size_t Role > \
     void setProperty( ValueType< Tag, Role >&& value ) { \
         auto& that = static_cast< ObjectType< Tag, Role >& >( *this ); \
-        PropertyBinding< Tag, Role >::value( that ) = std::forward< ValueType< Tag, Role > >( value ); \
+        { \
+            PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+            PropertyBinding< Tag, Role >::value( that ) = std::forward< ValueType< Tag, Role > >( value ); \
+            markChanged< Tag, Role >(); \
+        } \
         PropertyBinding< Tag, Role >::notify( that ); \
     } \
     \
     template< typename Tag, std::size_t Role, typename ...Args > \
     void setProperty( Args&& ...args ) { \
         auto& that = static_cast< ObjectType< Tag, Role >& >( *this ); \
-        PropertyBinding< Tag, Role >::value( that ) = ValueType< Tag, Role >{ args... }; \
+        { \
+            PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+            PropertyBinding< Tag, Role >::value( that ) = ValueType< Tag, Role >{ args... }; \
+            markChanged< Tag, Role >(); \
+        } \
         PropertyBinding< Tag, Role >::notify( that ); \
     } \
     \
+    /* Чтение свойства, согласованное с записью из другого потока. */ \
+    /* Посетитель получает копию значения или, для SharedValue, опубликованное значение. */ \
+    template< typename Tag, std::size_t Role, typename Visitor > \
+    void readProperty( Visitor&& visitor ) const { \
+        PropertyReader< Policy, Tag, ValueType< Tag, Role > >::read( m_lock, property< Tag, Role >(), visitor ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    auto readProperty() const -> typename PropertyReader< Policy, Tag, ValueType< Tag, Role > >::Result { \
+        typename PropertyReader< Policy, Tag, ValueType< Tag, Role > >::Result result; \
+        readProperty< Tag, Role >( [ &result ]( const decltype( result )& value ) { result = value; } ); \
+        return result; \
+    } \
+    \
 public: \
     template< typename Tag, typename ValueHolder > \
     bool toValue( std::size_t role, ValueHolder& holder ) { \
-        ToValueSelector< ValueHolder > selector{ role, holder }; \
-        return select< Tag >( selector, size_t_< 0 >{}, size_t_< COUNTER_READ( Tag ) - 1 >{} ); \
+        return dispatch< Tag, ToValueAction >( role, holder, std::make_index_sequence< COUNTER_READ( Tag ) >{} ); \
     } \
     \
     template< typename Tag, typename ValueHolder > \
     bool fromValue( std::size_t role, const ValueHolder& holder ) { \
-        FromValueSelector< ValueHolder > selector{ role, holder }; \
-        return select< Tag >( selector, size_t_< 0 >{}, size_t_< COUNTER_READ( Tag ) - 1 >{} ); \
+        return dispatch< Tag, FromValueAction >( role, holder, std::make_index_sequence< COUNTER_READ( Tag ) >{} ); \
     } \
     \
-private: \
-    template< typename ValueHolder > \
-    struct ToValueSelector { \
-        std::size_t role ; \
-        ValueHolder& holder; \
+    /* Пакет изменений свойств. Пока пакет открыт, значения свойств меняются сразу, */ \
+    /* а цепочки обработчиков откладываются до фиксации. При фиксации цепочки выполняются */ \
+    /* в порядке изменения свойств, обработчик, уже вызванный в этом пакете, пропускается. */ \
+    /* Вложенный пакет не фиксирует изменения, это делает внешний пакет. */ \
+    class BatchUpdate { \
+    public: \
+        explicit BatchUpdate( Object& object ) : m_object( &object ) { \
+            if ( !object.m_batch ) \
+                object.m_batch = this; \
+        } \
+        \
+        BatchUpdate( BatchUpdate&& other ) : m_object( other.m_object ), m_handlers( std::move( other.m_handlers ) ) { \
+            if ( m_object && m_object->m_batch == &other ) \
+                m_object->m_batch = this; \
+            other.m_object = nullptr; \
+        } \
+        \
+        BatchUpdate( const BatchUpdate& ) = delete; \
+        BatchUpdate& operator=( const BatchUpdate& ) = delete; \
+        \
+        ~BatchUpdate() { commit(); } \
         \
-        template< typename Tag, std::size_t Role > \
-        bool operator()( Tag, size_t_< Role >, const Object& object ) { \
-            if ( role == Role ) { \
-                holder = object.property< Tag, Role >(); \
-                return true; \
+        void commit() { \
+            Object* object = m_object; \
+            m_object = nullptr; \
+            if ( !object || object->m_batch != this ) \
+                return; \
+            object->m_batch = nullptr; \
+            \
+            std::vector< Handler > called; \
+            bool interrupted = false; \
+            for ( Handler handler : m_handlers ) { \
+                if ( !handler ) \
+                    interrupted = false; \
+                else if ( !interrupted && std::find( called.begin(), called.end(), handler ) == called.end() ) { \
+                    called.push_back( handler ); \
+                    interrupted = !handler( *object ); \
+                } \
             } \
+            m_handlers.clear(); \
+        } \
+        \
+    private: \
+        friend Object; \
+        \
+        void defer( std::initializer_list< Handler > handlers ) { \
+            if ( handlers.size() == 0 ) \
+                return; \
+            m_handlers.insert( m_handlers.end(), handlers ); \
+            m_handlers.push_back( nullptr ); \
+        } \
+        \
+        Object* m_object; \
+        std::vector< Handler > m_handlers; \
+    }; \
+    \
+    BatchUpdate batchUpdate() { \
+        return BatchUpdate( *this ); \
+    } \
+    \
+public: \
+    /* Свойство отмечается изменившимся при каждом вызове setProperty и resetProperty. */ \
+    /* Дельта содержит число свойств и для каждого свойства роль и закодированное значение, */ \
+    /* поэтому не зависит от порядка объявления свойств в процессах отправителя и получателя. */ \
+    template< typename Tag, std::size_t Role > \
+    bool isChanged() const { \
+        return m_changes.test( changeSlot< Tag, Role >() ); \
+    } \
+    \
+    template< typename Tag > \
+    bool hasChanges() const { \
+        return m_changes.any( changeMask< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ) ); \
+    } \
+    \
+    template< typename Tag > \
+    void markAllChanged() { \
+        m_changes.setAll( changeMask< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ) ); \
+    } \
+    \
+    template< typename Tag > \
+    void clearChanges() { \
+        m_changes.clear( changeMask< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ) ); \
+    } \
+    \
+    /* Дописывает в буфер дельту изменившихся свойств тега и сбрасывает их флаги. */ \
+    /* Возвращает число записанных свойств. */ \
+    template< typename Tag > \
+    std::size_t writeDelta( std::vector< char >& buffer ) { \
+        using Sequence = std::make_index_sequence< propertyCount< Tag >() >; \
+        const auto changed = m_changes.take( changeMask< Tag >( Sequence{} ) ); \
+        std::size_t count = Changes::count( changed ); \
+        writeVarint( buffer, count ); \
+        Changes::visit( changed, [ this, &buffer ]( std::size_t slot ) { \
+            dispatchIndex< Tag, WriteDeltaAction >( slotIndex< Tag >( slot, Sequence{} ), buffer, Sequence{} ); \
+        } ); \
+        return count; \
+    } \
+    \
+    /* Применяет дельту: значения присваиваются, обработчики вызываются одним пакетом, */ \
+    /* флаги изменения у получателя не выставляются. Возвращает false, если дельта */ \
+    /* повреждена или содержит неизвестную роль, уже прочитанные свойства при этом остаются примененными. */ \
+    template< typename Tag > \
+    bool applyDelta( const char* data, std::size_t size ) { \
+        DeltaReader reader{ data, data + size }; \
+        uint64_t count = 0; \
+        if ( !readVarint( reader.data, reader.end, count ) ) \
             return false; \
+        BatchUpdate batch( *this ); \
+        for ( uint64_t i = 0; i < count; ++i ) { \
+            uint64_t role = 0; \
+            if ( !readVarint( reader.data, reader.end, role ) || \
+                    !dispatch< Tag, ApplyDeltaAction >( std::size_t( role ), reader, \
+                            std::make_index_sequence< propertyCount< Tag >() >{} ) ) \
+                return false; \
+        } \
+        return reader.data == reader.end; \
+    } \
+    \
+public: \
+    /* Снимок начинается с версии, вычисленной по набору ролей и типов значений тега. */ \
+    /* Затем одним блоком копируются тривиально копируемые свойства, */ \
+    /* после них по одному кодируются остальные свойства (смотреть PropertyCodec). */ \
+    template< typename Tag > \
+    static constexpr uint64_t snapshotVersion() { \
+        return snapshotVersion< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ); \
+    } \
+    \
+    template< typename Tag > \
+    void snapshot( std::vector< char >& buffer ) const { \
+        constexpr uint64_t Version = snapshotVersion< Tag >(); \
+        constexpr std::size_t Size = plainSize< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ); \
+        const std::size_t offset = buffer.size(); \
+        buffer.resize( offset + sizeof( Version ) + Size ); \
+        char* data = &buffer[ offset ]; \
+        std::memcpy( data, &Version, sizeof( Version ) ); \
+        data += sizeof( Version ); \
+        snapshot< Tag >( data, buffer, std::make_index_sequence< propertyCount< Tag >() >{} ); \
+    } \
+    \
+    /* Восстанавливает свойства тега из снимка без вызова обработчиков и без отметки изменений. */ \
+    /* Возвращает число прочитанных байт, что позволяет читать снимки, записанные подряд, */ \
+    /* или 0, если версия снимка не совпадает или данных недостаточно. */ \
+    template< typename Tag > \
+    std::size_t restore( const char* data, std::size_t size ) { \
+        constexpr uint64_t Version = snapshotVersion< Tag >(); \
+        constexpr std::size_t Size = plainSize< Tag >( std::make_index_sequence< propertyCount< Tag >() >{} ); \
+        uint64_t version = 0; \
+        if ( size < sizeof( Version ) + Size ) \
+            return 0; \
+        std::memcpy( &version, data, sizeof( Version ) ); \
+        if ( version != Version ) \
+            return 0; \
+        DeltaReader reader{ data + sizeof( Version ), data + size }; \
+        if ( !restore< Tag >( reader, std::make_index_sequence< propertyCount< Tag >() >{} ) ) \
+            return 0; \
+        return std::size_t( reader.data - data ); \
+    } \
+    \
+private: \
+    struct ToValueAction { \
+        template< typename Tag, std::size_t Role, typename ValueHolder > \
+        static bool apply( Object& object, ValueHolder& holder ) { \
+            holder = object.property< Tag, Role >(); \
+            return true; \
         } \
     }; \
     \
-    template< typename ValueHolder > \
-    struct FromValueSelector { \
-        std::size_t role; \
-        const ValueHolder& holder; \
-        \
-        template< typename Tag, std::size_t Role > \
-        bool operator()( Tag, size_t_< Role >, Object& object ) { \
-            if ( role == Role ) { \
-                ValueType< Tag, Role > value = holder; \
-                object.setProperty< Tag, Role >( std::move( value ) ); \
-                return true; \
+    struct FromValueAction { \
+        template< typename Tag, std::size_t Role, typename ValueHolder > \
+        static bool apply( Object& object, ValueHolder& holder ) { \
+            ValueType< Tag, Role > value = holder; \
+            object.setProperty< Tag, Role >( std::move( value ) ); \
+            return true; \
+        } \
+    }; \
+    \
+    struct WriteDeltaAction { \
+        template< typename Tag, std::size_t Role, typename ValueHolder > \
+        static bool apply( Object& object, std::vector< char >& buffer ) { \
+            writeVarint( buffer, Role ); \
+            object.encodeProperty< Tag, Role >( buffer, std::integral_constant< bool, Policy::Optimistic >() ); \
+            return true; \
+        } \
+    }; \
+    \
+    struct DeltaReader { \
+        const char* data; \
+        const char* end; \
+    }; \
+    \
+    struct ApplyDeltaAction { \
+        template< typename Tag, std::size_t Role, typename ValueHolder > \
+        static bool apply( Object& object, DeltaReader& reader ) { \
+            auto& that = static_cast< ObjectType< Tag, Role >& >( object ); \
+            { \
+                PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( object.m_lock ); \
+                if ( !PropertyCodec< ValueType< Tag, Role > >::read( reader.data, reader.end, \
+                        PropertyBinding< Tag, Role >::value( that ) ) ) \
+                    return false; \
             } \
-            return false; \
+            PropertyBinding< Tag, Role >::notify( that ); \
+            return true; \
         } \
     }; \
     \
-    template< typename Tag, typename ValueSelector > \
-    bool select( ValueSelector&, size_t_< 0 >, size_t_< std::size_t( -1 ) > ) { \
+    template< typename Tag > \
+    static constexpr std::size_t propertyCount() { \
+        return COUNTER_READ( Tag ); \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    static constexpr std::size_t propertyIndex( std::size_t role, std::index_sequence< Index... > ) { \
+        return RoleTable< PropertyIdentity< Tag, Index >::BindingRole... >::find( role ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    static constexpr std::size_t propertyIndex() { \
+        return propertyIndex< Tag >( Role, std::make_index_sequence< propertyCount< Tag >() >{} ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    using IsPlain = std::is_trivially_copyable< ValueType< Tag, Role > >; \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    static constexpr uint64_t snapshotVersion( std::index_sequence< Index... > ) { \
+        const uint64_t items[] = { 0, ( uint64_t( PropertyIdentity< Tag, Index >::BindingRole ) << 32 ^ \
+            sizeof( ValueType< Tag, PropertyIdentity< Tag, Index >::BindingRole > ) << 1 ^ \
+            IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >::value )... }; \
+        uint64_t hash = 0xCBF29CE484222325ull; \
+        for ( std::size_t i = 1; i < sizeof( items ) / sizeof( items[ 0 ] ); ++i ) \
+            hash = ( hash ^ items[ i ] ) * 0x100000001B3ull; \
+        return hash; \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    static constexpr std::size_t plainSize( std::index_sequence< Index... > ) { \
+        const std::size_t sizes[] = { 0, ( IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >::value ? \
+            sizeof( ValueType< Tag, PropertyIdentity< Tag, Index >::BindingRole > ) : 0 )... }; \
+        std::size_t size = 0; \
+        for ( std::size_t value : sizes ) \
+            size += value; \
+        return size; \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    void snapshot( char* data, std::vector< char >& buffer, std::index_sequence< Index... > ) const { \
+        (void)data; \
+        (void)std::initializer_list< int >{ ( snapshotPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >( \
+            data, IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >() ), 0 )..., 0 }; \
+        (void)std::initializer_list< int >{ ( snapshotEncoded< Tag, PropertyIdentity< Tag, Index >::BindingRole >( \
+            buffer, IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >() ), 0 )..., 0 }; \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    void snapshotPlain( char*& data, std::true_type ) const { \
+        std::memcpy( data, &property< Tag, Role >(), sizeof( ValueType< Tag, Role > ) ); \
+        data += sizeof( ValueType< Tag, Role > ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    void snapshotPlain( char*&, std::false_type ) const {} \
+    \
+    template< typename Tag, std::size_t Role > \
+    void snapshotEncoded( std::vector< char >&, std::true_type ) const {} \
+    \
+    template< typename Tag, std::size_t Role > \
+    void snapshotEncoded( std::vector< char >& buffer, std::false_type ) const { \
+        PropertyCodec< ValueType< Tag, Role > >::write( buffer, property< Tag, Role >() ); \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    bool restore( DeltaReader& reader, std::index_sequence< Index... > ) { \
+        (void)std::initializer_list< int >{ ( restorePlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >( \
+            reader, IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >() ), 0 )..., 0 }; \
+        bool state = true; \
+        (void)std::initializer_list< int >{ ( state = state && restoreEncoded< Tag, PropertyIdentity< Tag, Index >::BindingRole >( \
+            reader, IsPlain< Tag, PropertyIdentity< Tag, Index >::BindingRole >() ), 0 )..., 0 }; \
+        return state; \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    void restorePlain( DeltaReader& reader, std::true_type ) { \
+        PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+        std::memcpy( &property< Tag, Role >(), reader.data, sizeof( ValueType< Tag, Role > ) ); \
+        reader.data += sizeof( ValueType< Tag, Role > ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    void restorePlain( DeltaReader&, std::false_type ) {} \
+    \
+    template< typename Tag, std::size_t Role > \
+    bool restoreEncoded( DeltaReader&, std::true_type ) { return true; } \
+    \
+    template< typename Tag, std::size_t Role > \
+    bool restoreEncoded( DeltaReader& reader, std::false_type ) { \
+        PropertyWriteGuard< Policy, Tag, ValueType< Tag, Role > > guard( m_lock ); \
+        return PropertyCodec< ValueType< Tag, Role > >::read( reader.data, reader.end, property< Tag, Role >() ); \
+    } \
+    \
+    /* Номер бита изменения свойства в наборе объекта и маска бит тега */ \
+    template< typename Tag, std::size_t Role > \
+    static constexpr std::size_t changeSlot() { \
+        return PropertyIdentity< Tag, propertyIndex< Tag, Role >() >::ChangeSlot; \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    static constexpr typename Changes::Mask changeMask( std::index_sequence< Index... > ) { \
+        return Changes::template mask< PropertyIdentity< Tag, Index >::ChangeSlot... >(); \
+    } \
+    \
+    template< typename Tag, std::size_t ...Index > \
+    static constexpr std::size_t slotIndex( std::size_t slot, std::index_sequence< Index... > ) { \
+        return RoleTable< PropertyIdentity< Tag, Index >::ChangeSlot... >::find( slot ); \
+    } \
+    \
+    /* Под seqlock значение для дельты читается так же, как readProperty, */ \
+    /* поэтому дельту можно снимать, не останавливая писателей. */ \
+    template< typename Tag, std::size_t Role > \
+    void encodeProperty( std::vector< char >& buffer, std::false_type ) const { \
+        PropertyCodec< ValueType< Tag, Role > >::write( buffer, property< Tag, Role >() ); \
+    } \
+    \
+    template< typename Tag, std::size_t Role > \
+    void encodeProperty( std::vector< char >& buffer, std::true_type ) const { \
+        using Result = typename PropertyReader< Policy, Tag, ValueType< Tag, Role > >::Result; \
+        readProperty< Tag, Role >( [ &buffer ]( const Result& value ) { PropertyCodec< Result >::write( buffer, value ); } ); \
+    } \
+    \
+    /* Флаг выставляется под захватом политики, после записи значения */ \
+    template< typename Tag, std::size_t Role > \
+    void markChanged() { \
+        m_changes.set( changeSlot< Tag, Role >() ); \
+    } \
+    \
+    /* Роль переводится в плотный индекс свойства по таблице RoleTable, */ \
+    /* действие вызывается одним переходом по таблице указателей, построенной при компиляции */ \
+    template< typename Tag, typename Action, typename ValueHolder, std::size_t ...Index > \
+    bool dispatch( std::size_t role, ValueHolder& holder, std::index_sequence< Index... > sequence ) { \
+        return dispatchIndex< Tag, Action >( propertyIndex< Tag >( role, sequence ), holder, sequence ); \
+    } \
+    \
+    template< typename Tag, typename Action, typename ValueHolder, std::size_t ...Index > \
+    bool dispatchIndex( std::size_t index, ValueHolder& holder, std::index_sequence< Index... > ) { \
+        static constexpr bool ( *table[] )( Object&, ValueHolder& ) = { &applyThunk< Tag, Action, ValueHolder, Index >... }; \
+        return index < sizeof...( Index ) && table[ index ]( *this, holder ); \
+    } \
+    \
+    template< typename Tag, typename Action, typename ValueHolder > \
+    bool dispatchIndex( std::size_t, ValueHolder&, std::index_sequence<> ) { \
         return false; \
     } \
     \
-    template< typename Tag, typename ValueSelector, std::size_t Index > \
-    bool select( ValueSelector& selector, size_t_< Index >, size_t_< Index > ) { \
-        constexpr std::size_t Role = PropertyIdentity< Tag, Index >::BindingRole; \
-        return selector( Tag{}, size_t_< Role >{}, *this ); \
+    template< typename Tag, typename Action, typename ValueHolder, std::size_t Index > \
+    static bool applyThunk( Object& object, ValueHolder& holder ) { \
+        return Action::template apply< Tag, PropertyIdentity< Tag, Index >::BindingRole, ValueHolder >( object, holder ); \
     } \
     \
-    template< typename Tag, typename ValueSelector, std::size_t Begin, std::size_t End > \
-    bool select( ValueSelector& selector, size_t_< Begin >, size_t_< End > ) { \
-        constexpr std::size_t Middle = ( Begin + End ) / 2; \
-        if ( select< Tag >( selector, size_t_< Begin >{}, size_t_< Middle >{} ) ) \
-            return true; \
-        return select< Tag >( selector, size_t_< Middle + 1 >{}, size_t_< End >{} ); \
+    template< typename ...Handlers > \
+    void notify( Handlers&& ...handlers ) { \
+        if ( m_batch ) \
+            m_batch->defer( { handlers... } ); \
+        else \
+            invoke( handlers... ); \
     } \
     \
     template< typename Handler, typename ...Tail > \
-    void notify( Handler&& handler, Tail&& ...tail ) { \
+    void invoke( Handler&& handler, Tail&& ...tail ) { \
        if ( !handler( *this ) ) \
            return; \
-       notify( tail... ); \
+       invoke( tail... ); \
     } \
     \
-    void notify() {}
+    void invoke() {} \
+    \
+    BatchUpdate* m_batch = nullptr; \
+    Changes m_changes; \
+    Policy m_lock;
 
 /**
  * Объявление идентификатора свойства класса.
  * Необходим для механизма интроспекции свойств объекта.
  */
 #define BIND_IDENTITY( Tag, Role, Object ) \
+BIND_IDENTITY_NAMED( PACK_ARGS( Tag ), Role, Object, COUNTER_CONCAT( property_ident_, __COUNTER__ ), \
+    COUNTER_CONCAT( property_slot_, __COUNTER__ ) )
+
+/* Значения счетчиков читаются один раз и запоминаются в псевдонимах с уникальными именами. */
+/* Номер в теге задает порядок свойств тега, номер бита изменения сквозной для всего объекта. */
+#define BIND_IDENTITY_NAMED( Tag, Role, Object, Ident, Slot ) \
+using Ident = size_t_< COUNTER_READ( PACK_ARGS( Tag ) ) >; \
+using Slot = size_t_< PROPERTY_SLOT_READ( Object::PropertyOwner ) >; \
+static_assert( Slot::value < PROPERTY_MAX_COUNT, "too many properties in the object, raise PROPERTY_MAX_COUNT" ); \
 template<> \
-struct Object::PropertyIdentity< PACK_ARGS( Tag ), COUNTER_READ( PACK_ARGS( Tag ) ) > { \
+struct Object::PropertyIdentity< PACK_ARGS( Tag ), Ident::value > { \
   static constexpr std::size_t BindingRole = Role; \
+  static constexpr std::size_t ChangeSlot = Slot::value; \
 }; \
-COUNTER_INC( PACK_ARGS( Tag ) )
+COUNTER_INC_FROM( PACK_ARGS( Tag ), Ident::value ) \
+PROPERTY_SLOT_INC_FROM( Object::PropertyOwner, Slot::value )
 
 /**
  * Объявление свойства класса с привязкой к указанной роли и тегу.
@@ -221,3 +1101,264 @@ struct Object::PropertyBinding< Tag, Role > { \
     static void notify( ObjectType& object ) { object.notify( __VA_ARGS__ ); } \
 }; \
 BIND_IDENTITY( PACK_ARGS( Tag ), Role, Object )
+
+/**
+ * Коллекция объектов, хранящая свойства перечисленных тегов по столбцам (struct of arrays).
+ * Состав столбцов берется из объявлений BIND_PROPERTY класса Object, поэтому коллекцию
+ * следует объявлять после всех свойств. Каждое свойство хранится в собственном непрерывном массиве,
+ * что позволяет просматривать одно свойство у всех объектов без чтения остальных свойств.
+ * Доступ к свойствам повторяет методы BIND_OBJECT с дополнительным номером строки:
+ *
+ *     PropertyColumns< Object, Tag > columns( count );
+ *     columns.setProperty< Tag, Role >( index, value );
+ *     auto& value = columns.property< Tag, Role >( index );
+ *     const auto* values = columns.column< Tag, Role >().data();
+ *
+ * Обработчики BIND_PROPERTY принимают объект и к строке коллекции неприменимы,
+ * поэтому обработчики изменения столбца регистрируются в коллекции методом addHandler.
+ * Сигнатура обработчика: bool( *Handler )( PropertyColumns&, std::size_t index ),
+ * если обработчик возвращает false, цепочка выполнения прерывается.
+ * Свойства типа bool в коллекции не поддерживаются: std::vector< bool > не выдает ссылок bool&
+ * и не имеет data(), такие свойства следует объявлять как char.
+ */
+template< typename Object, typename ...Tags >
+class PropertyColumns {
+    template< typename Tag, std::size_t Role >
+    using ValueType = typename Object::template PropertyBinding< Tag, Role >::ValueType;
+
+    template< typename Value >
+    struct Column {
+        static_assert( !std::is_same< Value, bool >::value, "use char instead of bool: std::vector< bool > has no data()" );
+        using Type = std::vector< Value >;
+    };
+
+    template< typename Tag, typename Sequence >
+    struct TagColumns;
+
+    template< typename Tag, std::size_t ...Index >
+    struct TagColumns< Tag, std::index_sequence< Index... > > {
+        using Type = std::tuple< typename Column< ValueType< Tag, Object::template PropertyIdentity< Tag, Index >::BindingRole > >::Type... >;
+    };
+
+    template< typename Tag >
+    using Columns = typename TagColumns< Tag, std::make_index_sequence< Object::template propertyCount< Tag >() > >::Type;
+
+public:
+    using Handler = bool( * )( PropertyColumns&, std::size_t );
+
+    explicit PropertyColumns( std::size_t size = 0 ) : m_handlers( columnOffset( sizeof...( Tags ) ) ) {
+        resize( size );
+    }
+
+    std::size_t size() const {
+        return m_size;
+    }
+
+    void resize( std::size_t size ) {
+        forEachColumn( [ size ]( auto& column ) { column.resize( size ); } );
+        m_size = size;
+    }
+
+    void reserve( std::size_t size ) {
+        forEachColumn( [ size ]( auto& column ) { column.reserve( size ); } );
+    }
+
+    void clear() {
+        resize( 0 );
+    }
+
+    /* Добавляет строку со значениями свойств по умолчанию и возвращает ее номер */
+    std::size_t append() {
+        forEachColumn( []( auto& column ) { column.emplace_back(); } );
+        return m_size++;
+    }
+
+    /* Удаляет строку, перемещая на ее место последнюю строку */
+    void erase( std::size_t index ) {
+        const bool last = index + 1 == m_size;
+        forEachColumn( [ index, last ]( auto& column ) {
+            if ( !last )
+                column[ index ] = std::move( column.back() );
+            column.pop_back();
+        } );
+        --m_size;
+    }
+
+    template< typename Tag, std::size_t Role >
+    auto column() const -> const std::vector< ValueType< Tag, Role > >& {
+        return std::get< propertyIndex< Tag, Role >() >( std::get< tagIndex< Tag >() >( m_columns ) );
+    }
+
+    template< typename Tag, std::size_t Role >
+    auto column() -> std::vector< ValueType< Tag, Role > >& {
+        return std::get< propertyIndex< Tag, Role >() >( std::get< tagIndex< Tag >() >( m_columns ) );
+    }
+
+    template< typename Tag, std::size_t Role >
+    auto property( std::size_t index ) const -> const ValueType< Tag, Role >& {
+        return column< Tag, Role >()[ index ];
+    }
+
+    template< typename Tag, std::size_t Role >
+    auto property( std::size_t index ) -> ValueType< Tag, Role >& {
+        return column< Tag, Role >()[ index ];
+    }
+
+    template< typename Tag, std::size_t Role >
+    void resetProperty( std::size_t index ) {
+        column< Tag, Role >()[ index ] = {};
+        notify< Tag, Role >( index );
+    }
+
+    template< typename Tag, std::size_t Role >
+    void setProperty( std::size_t index, const ValueType< Tag, Role >& value ) {
+        column< Tag, Role >()[ index ] = value;
+        notify< Tag, Role >( index );
+    }
+
+    template< typename Tag, std::size_t Role >
+    void setProperty( std::size_t index, ValueType< Tag, Role >&& value ) {
+        column< Tag, Role >()[ index ] = std::move( value );
+        notify< Tag, Role >( index );
+    }
+
+    template< typename Tag, std::size_t Role, typename ...Args >
+    void setProperty( std::size_t index, Args&& ...args ) {
+        column< Tag, Role >()[ index ] = ValueType< Tag, Role >{ args... };
+        notify< Tag, Role >( index );
+    }
+
+    template< typename Tag, typename ValueHolder >
+    bool toValue( std::size_t index, std::size_t role, ValueHolder& holder ) {
+        return dispatch< Tag, ToValueAction >( index, role, holder, std::make_index_sequence< Object::template propertyCount< Tag >() >{} );
+    }
+
+    template< typename Tag, typename ValueHolder >
+    bool fromValue( std::size_t index, std::size_t role, const ValueHolder& holder ) {
+        return dispatch< Tag, FromValueAction >( index, role, holder, std::make_index_sequence< Object::template propertyCount< Tag >() >{} );
+    }
+
+    template< typename Tag, std::size_t Role >
+    void addHandler( Handler handler ) {
+        m_handlers[ columnOffset( tagIndex< Tag >() ) + propertyIndex< Tag, Role >() ].push_back( handler );
+    }
+
+    /* Копирование свойств объекта в строку коллекции, обработчики коллекции не вызываются */
+    void load( std::size_t index, const Object& object ) {
+        (void)std::initializer_list< int >{ ( transfer< Tags, LoadAction >( *this, index, object,
+            std::make_index_sequence< Object::template propertyCount< Tags >() >() ), 0 )..., 0 };
+    }
+
+    /* Копирование строки коллекции в объект через setProperty, с вызовом обработчиков объекта */
+    void store( std::size_t index, Object& object ) const {
+        (void)std::initializer_list< int >{ ( transfer< Tags, StoreAction >( *this, index, object,
+            std::make_index_sequence< Object::template propertyCount< Tags >() >() ), 0 )..., 0 };
+    }
+
+private:
+    struct ToValueAction {
+        template< typename Tag, std::size_t Role, typename ValueHolder >
+        static bool apply( PropertyColumns& columns, std::size_t index, ValueHolder& holder ) {
+            holder = columns.property< Tag, Role >( index );
+            return true;
+        }
+    };
+
+    struct FromValueAction {
+        template< typename Tag, std::size_t Role, typename ValueHolder >
+        static bool apply( PropertyColumns& columns, std::size_t index, ValueHolder& holder ) {
+            ValueType< Tag, Role > value = holder;
+            columns.setProperty< Tag, Role >( index, std::move( value ) );
+            return true;
+        }
+    };
+
+    struct LoadAction {
+        template< typename Tag, std::size_t Role >
+        static void apply( PropertyColumns& columns, std::size_t index, const Object& object ) {
+            columns.property< Tag, Role >( index ) = object.template property< Tag, Role >();
+        }
+    };
+
+    struct StoreAction {
+        template< typename Tag, std::size_t Role >
+        static void apply( const PropertyColumns& columns, std::size_t index, Object& object ) {
+            object.template setProperty< Tag, Role >( columns.property< Tag, Role >( index ) );
+        }
+    };
+
+    template< typename Tag >
+    static constexpr std::size_t tagIndex() {
+        const bool same[] = { std::is_same< Tag, Tags >::value... };
+        std::size_t index = 0;
+        while ( index < sizeof...( Tags ) && !same[ index ] )
+            ++index;
+        return index;
+    }
+
+    static constexpr std::size_t columnOffset( std::size_t tag ) {
+        const std::size_t counts[] = { Object::template propertyCount< Tags >()... };
+        std::size_t offset = 0;
+        for ( std::size_t i = 0; i < tag; ++i )
+            offset += counts[ i ];
+        return offset;
+    }
+
+    template< typename Tag, std::size_t Role >
+    static constexpr std::size_t propertyIndex() {
+        static_assert( tagIndex< Tag >() < sizeof...( Tags ), "tag is not stored in the collection" );
+        return Object::template propertyIndex< Tag, Role >();
+    }
+
+    template< typename Function >
+    void forEachColumn( Function&& function ) {
+        forEachColumn( function, std::index_sequence_for< Tags... >() );
+    }
+
+    template< typename Function, std::size_t ...Tag >
+    void forEachColumn( Function& function, std::index_sequence< Tag... > ) {
+        (void)std::initializer_list< int >{ ( forEachColumn( function, std::get< Tag >( m_columns ),
+            std::make_index_sequence< std::tuple_size< typename std::tuple_element< Tag, decltype( m_columns ) >::type >::value >() ), 0 )..., 0 };
+    }
+
+    template< typename Function, typename Tuple, std::size_t ...Index >
+    static void forEachColumn( Function& function, Tuple& columns, std::index_sequence< Index... > ) {
+        (void)std::initializer_list< int >{ ( function( std::get< Index >( columns ) ), 0 )..., 0 };
+    }
+
+    template< typename Tag, typename Action, typename That, typename Target, std::size_t ...Index >
+    static void transfer( That& that, std::size_t index, Target& object, std::index_sequence< Index... > ) {
+        (void)std::initializer_list< int >{ ( Action::template apply< Tag, Object::template PropertyIdentity< Tag, Index >::BindingRole >(
+            that, index, object ), 0 )..., 0 };
+    }
+
+    template< typename Tag, typename Action, typename ValueHolder, std::size_t ...Index >
+    bool dispatch( std::size_t row, std::size_t role, ValueHolder& holder, std::index_sequence< Index... > sequence ) {
+        static constexpr bool ( *table[] )( PropertyColumns&, std::size_t, ValueHolder& ) = {
+            &applyThunk< Tag, Action, ValueHolder, Index >... };
+        const std::size_t index = Object::template propertyIndex< Tag >( role, sequence );
+        return index < sizeof...( Index ) && table[ index ]( *this, row, holder );
+    }
+
+    template< typename Tag, typename Action, typename ValueHolder >
+    bool dispatch( std::size_t, std::size_t, ValueHolder&, std::index_sequence<> ) {
+        return false;
+    }
+
+    template< typename Tag, typename Action, typename ValueHolder, std::size_t Index >
+    static bool applyThunk( PropertyColumns& columns, std::size_t row, ValueHolder& holder ) {
+        return Action::template apply< Tag, Object::template PropertyIdentity< Tag, Index >::BindingRole, ValueHolder >( columns, row, holder );
+    }
+
+    template< typename Tag, std::size_t Role >
+    void notify( std::size_t index ) {
+        for ( Handler handler : m_handlers[ columnOffset( tagIndex< Tag >() ) + propertyIndex< Tag, Role >() ] ) {
+            if ( !handler( *this, index ) )
+                return;
+        }
+    }
+
+    std::tuple< Columns< Tags >... > m_columns;
+    std::vector< std::vector< Handler > > m_handlers;
+    std::size_t m_size = 0;
+};
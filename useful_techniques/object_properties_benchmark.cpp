@@ -0,0 +1,351 @@
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+/* Dense512 и Sparse512 объявляют по 512 свойств */
+#define PROPERTY_MAX_COUNT 512
+#include "object_properties.h"
+
+/**
+ * Объекты с заданным числом свойств. Четные свойства целочисленные, нечетные - вещественные,
+ * чтобы компилятор не мог свести перебор однотипных свойств к индексации одного массива.
+ * Роль свойства с номером Index равна Index * Stride: Stride = 1 дает плотные роли,
+ * большой шаг - разреженные, для которых используется хеш-таблица ролей.
+ * Для каждого объекта заводится собственный тег, так как счетчик свойств общий для тега.
+ */
+#define PROPERTY_1( Object, Index ) \
+    BIND_PROPERTY( Object::Tag, ( Index ) * Object::Stride, Object, value< ( Index ) >(), &Object::changed )
+#define PROPERTY_8( Object, Index ) \
+    PROPERTY_1( Object, ( Index ) * 8 + 0 ) PROPERTY_1( Object, ( Index ) * 8 + 1 ) \
+    PROPERTY_1( Object, ( Index ) * 8 + 2 ) PROPERTY_1( Object, ( Index ) * 8 + 3 ) \
+    PROPERTY_1( Object, ( Index ) * 8 + 4 ) PROPERTY_1( Object, ( Index ) * 8 + 5 ) \
+    PROPERTY_1( Object, ( Index ) * 8 + 6 ) PROPERTY_1( Object, ( Index ) * 8 + 7 )
+#define PROPERTY_64( Object, Index ) \
+    PROPERTY_8( Object, ( Index ) * 8 + 0 ) PROPERTY_8( Object, ( Index ) * 8 + 1 ) \
+    PROPERTY_8( Object, ( Index ) * 8 + 2 ) PROPERTY_8( Object, ( Index ) * 8 + 3 ) \
+    PROPERTY_8( Object, ( Index ) * 8 + 4 ) PROPERTY_8( Object, ( Index ) * 8 + 5 ) \
+    PROPERTY_8( Object, ( Index ) * 8 + 6 ) PROPERTY_8( Object, ( Index ) * 8 + 7 )
+#define PROPERTY_512( Object, Index ) \
+    PROPERTY_64( Object, ( Index ) * 8 + 0 ) PROPERTY_64( Object, ( Index ) * 8 + 1 ) \
+    PROPERTY_64( Object, ( Index ) * 8 + 2 ) PROPERTY_64( Object, ( Index ) * 8 + 3 ) \
+    PROPERTY_64( Object, ( Index ) * 8 + 4 ) PROPERTY_64( Object, ( Index ) * 8 + 5 ) \
+    PROPERTY_64( Object, ( Index ) * 8 + 6 ) PROPERTY_64( Object, ( Index ) * 8 + 7 )
+
+#define DECLARE_OBJECT( Object, PropertyCount, RoleStride ) \
+class Object { \
+    BIND_OBJECT( Object ) \
+public: \
+    struct Tag {}; \
+    static constexpr std::size_t Count = PropertyCount; \
+    static constexpr std::size_t Stride = RoleStride; \
+    \
+    Object() = default; \
+    static bool changed( Object& ) { return true; } \
+    \
+    template< std::size_t Index > \
+    auto value() -> typename std::enable_if< Index % 2 == 0, int& >::type { return ints[ Index / 2 ]; } \
+    \
+    template< std::size_t Index > \
+    auto value() -> typename std::enable_if< Index % 2 == 1, double& >::type { return doubles[ Index / 2 ]; } \
+    \
+    int ints[ PropertyCount / 2 ] = {}; \
+    double doubles[ PropertyCount / 2 ] = {}; \
+}; \
+PROPERTY_##PropertyCount( Object, 0 )
+
+DECLARE_OBJECT( Dense8, 8, 1 )
+DECLARE_OBJECT( Dense64, 64, 1 )
+DECLARE_OBJECT( Dense512, 512, 1 )
+DECLARE_OBJECT( Sparse8, 8, 1009 )
+DECLARE_OBJECT( Sparse64, 64, 1009 )
+DECLARE_OBJECT( Sparse512, 512, 1009 )
+
+/**
+ * Объект, свойства которого пишут несколько потоков: целые под общим seqlock и строка в SharedValue
+ */
+class SharedCounters {
+    BIND_CONCURRENT_OBJECT( SharedCounters, PropertyObjectLock )
+public:
+    struct Tag {};
+
+    SharedCounters() = default;
+
+    int64_t counters[ 4 ] = {};
+    SharedValue< std::string > name;
+};
+
+BIND_PROPERTY( SharedCounters::Tag, 0, SharedCounters, counters[ 0 ] )
+BIND_PROPERTY( SharedCounters::Tag, 1, SharedCounters, counters[ 1 ] )
+BIND_PROPERTY( SharedCounters::Tag, 2, SharedCounters, counters[ 2 ] )
+BIND_PROPERTY( SharedCounters::Tag, 3, SharedCounters, counters[ 3 ] )
+BIND_PROPERTY( SharedCounters::Tag, 4, SharedCounters, name )
+
+/**
+ * Прежний способ поиска роли: последовательное сравнение со всеми объявленными ролями
+ */
+template< typename Object, std::size_t ...Index >
+static bool chainToValue( Object& object, std::size_t role, int& holder, std::index_sequence< Index... > ) {
+    bool found = false;
+    (void)std::initializer_list< int >{ ( found = found || ( role == Index * Object::Stride &&
+            ( holder = object.template property< typename Object::Tag, Index * Object::Stride >(), true ) ), 0 )... };
+    return found;
+}
+
+template< typename Object, std::size_t ...Index >
+static bool chainFromValue( Object& object, std::size_t role, int holder, std::index_sequence< Index... > ) {
+    bool found = false;
+    (void)std::initializer_list< int >{ ( found = found || ( role == Index * Object::Stride &&
+            ( object.template setProperty< typename Object::Tag, Index * Object::Stride >( static_cast< typename std::decay<
+                    decltype( object.template property< typename Object::Tag, Index * Object::Stride >() ) >::type >( holder ) ), true ) ), 0 )... };
+    return found;
+}
+
+struct Chain {
+    template< typename Object >
+    static bool toValue( Object& object, std::size_t role, int& holder ) {
+        return chainToValue( object, role, holder, std::make_index_sequence< Object::Count >{} );
+    }
+
+    template< typename Object >
+    static bool fromValue( Object& object, std::size_t role, int holder ) {
+        return chainFromValue( object, role, holder, std::make_index_sequence< Object::Count >{} );
+    }
+};
+
+struct Table {
+    template< typename Object >
+    static bool toValue( Object& object, std::size_t role, int& holder ) {
+        return object.template toValue< typename Object::Tag >( role, holder );
+    }
+
+    template< typename Object >
+    static bool fromValue( Object& object, std::size_t role, int holder ) {
+        return object.template fromValue< typename Object::Tag >( role, holder );
+    }
+};
+
+/**
+ * Случайная последовательность существующих ролей, чтобы исключить угадывание переходов
+ */
+template< typename Object >
+static std::vector< std::size_t > randomRoles() {
+    std::mt19937 random( 42 );
+    std::vector< std::size_t > roles( 4096 );
+    for ( auto& role : roles )
+        role = ( random() % Object::Count ) * Object::Stride;
+    return roles;
+}
+
+template< typename Object, typename Dispatch >
+static void ToValue( benchmark::State& state ) {
+    Object object;
+    auto roles = randomRoles< Object >();
+    for ( auto _ : state ) {
+        for ( std::size_t role : roles ) {
+            int value = 0;
+            benchmark::DoNotOptimize( Dispatch::toValue( object, role, value ) );
+            benchmark::DoNotOptimize( value );
+        }
+    }
+    state.SetItemsProcessed( state.iterations() * roles.size() );
+}
+
+template< typename Object, typename Dispatch >
+static void FromValue( benchmark::State& state ) {
+    Object object;
+    auto roles = randomRoles< Object >();
+    for ( auto _ : state ) {
+        for ( std::size_t role : roles )
+            benchmark::DoNotOptimize( Dispatch::fromValue( object, role, int( role ) ) );
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed( state.iterations() * roles.size() );
+}
+
+/**
+ * Дельта изменившихся свойств: стоимость записи и применения должна расти
+ * с числом изменившихся свойств, а не с числом свойств объекта
+ */
+template< typename Object >
+static void WriteDelta( benchmark::State& state ) {
+    Object object;
+    auto roles = randomRoles< Object >();
+    roles.resize( std::size_t( state.range( 0 ) ) );
+    std::vector< char > buffer;
+    for ( auto _ : state ) {
+        for ( std::size_t role : roles )
+            object.template fromValue< typename Object::Tag >( role, int( role ) );
+        buffer.clear();
+        benchmark::DoNotOptimize( object.template writeDelta< typename Object::Tag >( buffer ) );
+        benchmark::DoNotOptimize( buffer.data() );
+    }
+    state.SetItemsProcessed( state.iterations() * roles.size() );
+}
+
+template< typename Object >
+static void ApplyDelta( benchmark::State& state ) {
+    Object object, replica;
+    auto roles = randomRoles< Object >();
+    roles.resize( std::size_t( state.range( 0 ) ) );
+    for ( std::size_t role : roles )
+        object.template fromValue< typename Object::Tag >( role, int( role ) );
+    std::vector< char > buffer;
+    object.template writeDelta< typename Object::Tag >( buffer );
+    for ( auto _ : state ) {
+        benchmark::DoNotOptimize( replica.template applyDelta< typename Object::Tag >( buffer.data(), buffer.size() ) );
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed( state.iterations() * roles.size() );
+}
+
+/**
+ * Снимок всех свойств объекта в сравнении с прежним способом - чтением каждой роли через toValue
+ */
+template< typename Object >
+static void ToValueCheckpoint( benchmark::State& state ) {
+    std::vector< Object > objects( 1024 );
+    std::vector< double > buffer;
+    for ( auto _ : state ) {
+        buffer.clear();
+        for ( Object& object : objects ) {
+            for ( std::size_t index = 0; index < Object::Count; ++index ) {
+                double value = 0;
+                object.template toValue< typename Object::Tag >( index * Object::Stride, value );
+                buffer.push_back( value );
+            }
+        }
+        benchmark::DoNotOptimize( buffer.data() );
+    }
+    state.SetItemsProcessed( state.iterations() * objects.size() );
+}
+
+template< typename Object >
+static void Snapshot( benchmark::State& state ) {
+    std::vector< Object > objects( 1024 );
+    std::vector< char > buffer;
+    for ( auto _ : state ) {
+        buffer.clear();
+        for ( const Object& object : objects )
+            object.template snapshot< typename Object::Tag >( buffer );
+        benchmark::DoNotOptimize( buffer.data() );
+    }
+    state.SetItemsProcessed( state.iterations() * objects.size() );
+}
+
+template< typename Object >
+static void Restore( benchmark::State& state ) {
+    std::vector< Object > objects( 1024 );
+    std::vector< char > buffer;
+    for ( const Object& object : objects )
+        object.template snapshot< typename Object::Tag >( buffer );
+    for ( auto _ : state ) {
+        const char* data = buffer.data();
+        for ( Object& object : objects )
+            data += object.template restore< typename Object::Tag >( data, std::size_t( buffer.data() + buffer.size() - data ) );
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed( state.iterations() * objects.size() );
+}
+
+/**
+ * Просмотр одного свойства у всех объектов: объекты целиком против столбцов PropertyColumns
+ */
+template< typename Object >
+static void ObjectScan( benchmark::State& state ) {
+    std::vector< Object > objects( std::size_t( state.range( 0 ) ) );
+    for ( auto _ : state ) {
+        double sum = 0;
+        for ( const Object& object : objects )
+            sum += object.template property< typename Object::Tag, Object::Stride >();
+        benchmark::DoNotOptimize( sum );
+    }
+    state.SetItemsProcessed( state.iterations() * objects.size() );
+}
+
+template< typename Object >
+static void ColumnScan( benchmark::State& state ) {
+    PropertyColumns< Object, typename Object::Tag > columns( std::size_t( state.range( 0 ) ) );
+    for ( auto _ : state ) {
+        double sum = 0;
+        for ( double value : columns.template column< typename Object::Tag, Object::Stride >() )
+            sum += value;
+        benchmark::DoNotOptimize( sum );
+    }
+    state.SetItemsProcessed( state.iterations() * columns.size() );
+}
+
+/**
+ * Запись свойств из нескольких потоков, поток 0 при этом снимает дельты и применяет их к реплике.
+ * После остановки писателей последняя дельта должна привести реплику к значениям объекта,
+ * иначе флаг изменения потерян. Под -fsanitize=thread служит стресс-тестом флагов изменения.
+ */
+static void ConcurrentWrite( benchmark::State& state ) {
+    static SharedCounters object;
+    static SharedCounters replica;
+    static std::vector< char > buffer;
+    const std::size_t index = std::size_t( state.thread_index() ) % 4;
+
+    int64_t value = 0;
+    for ( auto _ : state ) {
+        switch ( index ) {
+            case 0: object.setProperty< SharedCounters::Tag, 0 >( ++value ); break;
+            case 1: object.setProperty< SharedCounters::Tag, 1 >( ++value ); break;
+            case 2: object.setProperty< SharedCounters::Tag, 2 >( ++value ); break;
+            default: object.setProperty< SharedCounters::Tag, 3 >( ++value ); break;
+        }
+        if ( value % 64 == 0 )
+            object.setProperty< SharedCounters::Tag, 4 >( std::to_string( value ) );
+        if ( state.thread_index() == 0 && value % 16 == 0 ) {
+            buffer.clear();
+            object.writeDelta< SharedCounters::Tag >( buffer );
+            replica.applyDelta< SharedCounters::Tag >( buffer.data(), buffer.size() );
+        }
+    }
+    state.SetItemsProcessed( state.iterations() );
+
+    if ( state.thread_index() == 0 ) {
+        buffer.clear();
+        object.writeDelta< SharedCounters::Tag >( buffer );
+        replica.applyDelta< SharedCounters::Tag >( buffer.data(), buffer.size() );
+        if ( !std::equal( object.counters, object.counters + 4, replica.counters ) ||
+                object.name.get() != replica.name.get() )
+            state.SkipWithError( "replica differs from the object, a change flag was lost" );
+    }
+}
+
+#define DISPATCH_BENCHMARK( Object ) \
+    BENCHMARK_TEMPLATE( ToValue, Object, Chain ); \
+    BENCHMARK_TEMPLATE( ToValue, Object, Table ); \
+    BENCHMARK_TEMPLATE( FromValue, Object, Chain ); \
+    BENCHMARK_TEMPLATE( FromValue, Object, Table )
+
+DISPATCH_BENCHMARK( Dense8 );
+DISPATCH_BENCHMARK( Dense64 );
+DISPATCH_BENCHMARK( Dense512 );
+DISPATCH_BENCHMARK( Sparse8 );
+DISPATCH_BENCHMARK( Sparse64 );
+DISPATCH_BENCHMARK( Sparse512 );
+
+BENCHMARK_TEMPLATE( WriteDelta, Dense512 )->Arg( 1 )->Arg( 8 )->Arg( 64 )->Arg( 512 );
+BENCHMARK_TEMPLATE( ApplyDelta, Dense512 )->Arg( 1 )->Arg( 8 )->Arg( 64 )->Arg( 512 );
+
+BENCHMARK_TEMPLATE( ToValueCheckpoint, Dense64 );
+BENCHMARK_TEMPLATE( Snapshot, Dense64 );
+BENCHMARK_TEMPLATE( Restore, Dense64 );
+
+BENCHMARK_TEMPLATE( ObjectScan, Dense64 )->Arg( 1 << 10 )->Arg( 1 << 17 );
+BENCHMARK_TEMPLATE( ColumnScan, Dense64 )->Arg( 1 << 10 )->Arg( 1 << 17 );
+
+BENCHMARK( ConcurrentWrite )->Threads( 1 )->Threads( 2 )->Threads( 4 )->UseRealTime();
+
+int main( int argc, char** argv ) {
+    benchmark::Initialize( &argc, argv );
+    if ( benchmark::ReportUnrecognizedArguments( argc, argv ) )
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
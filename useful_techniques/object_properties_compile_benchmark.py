@@ -0,0 +1,160 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+Замер времени и памяти компиляции счетчика свойств из object_properties.h.
+
+Для каждого числа свойств генерируются заголовки и единица трансляции:
+    counter    - только COUNTER_INC/COUNTER_READ текущей реализации;
+    legacy     - прежний счетчик (11 разрядов, 5 чтений на свойство), до 2047 значений;
+    properties - объект с BIND_PROPERTY и вызовом toValue по всем свойствам.
+
+Пример запуска:
+    python object_properties_compile_benchmark.py --counts 100 1000 10000 --cxx g++
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+LEGACY_COUNTER = '''#pragma once
+#include <cstddef>
+#include <type_traits>
+
+template< std::size_t Index >
+struct size_t_ : std::integral_constant< std::size_t, Index > {
+};
+
+template< typename Tag, std::size_t Base, std::size_t Tail >
+constexpr size_t_< Tail > counter_reminder( Tag, size_t_< Base >, size_t_< Tail > ) {
+    return {};
+}
+
+#define PACK_ARGS( ... ) __VA_ARGS__
+
+#define COUNTER_READ_BASE( Tag, Base, Tail ) \\
+counter_reminder( PACK_ARGS( Tag ){}, size_t_< Base >(), size_t_< Tail >() )
+
+#define COUNTER_READ( Tag ) \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 1, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 2, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 4, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 8, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 16, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 32, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 64, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 128, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 256, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 512, \\
+COUNTER_READ_BASE( PACK_ARGS( Tag ), 1024, \\
+        0 ) ) ) ) ) ) ) ) ) ) )
+
+#define COUNTER_INC( Tag ) \\
+constexpr size_t_< COUNTER_READ( PACK_ARGS( Tag ) ) + 1 > \\
+counter_reminder( Tag&&, \\
+        size_t_< ( COUNTER_READ( PACK_ARGS( Tag ) ) + 1 ) & ~COUNTER_READ( PACK_ARGS( Tag ) ) >, \\
+        size_t_< ( COUNTER_READ( PACK_ARGS( Tag ) ) + 1 ) & COUNTER_READ( PACK_ARGS( Tag ) ) > ) \\
+        { return {}; }
+
+/* Прежний BIND_IDENTITY читал счетчик еще раз перед увеличением */
+#define BENCHMARK_INC( Tag ) \\
+static_assert( COUNTER_READ( Tag ) >= 0, "" ); \\
+COUNTER_INC( Tag )
+'''
+
+CURRENT_COUNTER = '''#pragma once
+#include "object_properties.h"
+
+/* Текущий COUNTER_INC читает счетчик один раз, как и BIND_IDENTITY */
+#define BENCHMARK_INC( Tag ) COUNTER_INC( Tag )
+'''
+
+
+def counter_source(count):
+    lines = ['#include "counter.h"', 'struct Tag {};']
+    lines += ['BENCHMARK_INC( Tag )'] * count
+    lines.append('static_assert( COUNTER_READ( Tag ) == %d, "" );' % count)
+    lines.append('int main() { return 0; }')
+    return '\n'.join(lines) + '\n'
+
+
+def properties_source(count):
+    lines = [
+        '#include "object_properties.h"',
+        'struct Tag {};',
+        'class Object {',
+        '    BIND_OBJECT( Object )',
+        'public:',
+        '    Object() = default;',
+        '    double values[ %d ] = {};' % count,
+        '};']
+    lines += ['BIND_PROPERTY( Tag, %d, Object, values[ %d ] )' % (i, i) for i in range(count)]
+    lines += [
+        'int main( int argc, char** ) {',
+        '    Object object;',
+        '    double value = 0;',
+        '    object.toValue< Tag >( std::size_t( argc ), value );',
+        '    return int( value );',
+        '}']
+    return '\n'.join(lines) + '\n'
+
+
+def compile_once(cxx, flags, directory, source):
+    path = os.path.join(directory, 'main.cpp')
+    with open(path, 'w') as file:
+        file.write(source)
+
+    command = [cxx, '-std=c++14', '-fsyntax-only', '-I', HERE, '-I', directory] + flags + [path]
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+    stderr = process.stderr.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    elapsed = time.perf_counter() - start
+    if status != 0:
+        return None, stderr.decode(errors='replace').splitlines()[:3]
+    return (elapsed, usage.ru_maxrss / 1024.), None
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--counts', type=int, nargs='+', default=[100, 1000, 10000])
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'g++'))
+    parser.add_argument('--variants', nargs='+', default=['legacy', 'counter', 'properties'])
+    parser.add_argument('flags', nargs='*', help='дополнительные флаги компилятора')
+    args = parser.parse_args()
+
+    print('%-12s %8s %10s %10s' % ('variant', 'count', 'time, s', 'rss, MiB'))
+    for variant in args.variants:
+        for count in args.counts:
+            if variant == 'legacy' and count > 2047:
+                print('%-12s %8d %10s %10s' % (variant, count, '-', '-'))
+                continue
+
+            flags = list(args.flags)
+            if count >= 1 << 16:
+                flags.append('-DCOUNTER_MAX_BITS=%d' % count.bit_length())
+            if variant == 'properties':
+                flags.append('-ftemplate-depth=%d' % max(1024, count + 64))
+                flags.append('-DPROPERTY_MAX_COUNT=%d' % max(256, count))
+
+            with tempfile.TemporaryDirectory() as directory:
+                if variant != 'properties':
+                    with open(os.path.join(directory, 'counter.h'), 'w') as file:
+                        file.write(LEGACY_COUNTER if variant == 'legacy' else CURRENT_COUNTER)
+                source = properties_source(count) if variant == 'properties' else counter_source(count)
+                result, errors = compile_once(args.cxx, flags, directory, source)
+
+            if result is None:
+                print('%-12s %8d %10s %10s  %s' % (variant, count, 'error', '-', ' / '.join(errors)))
+            else:
+                print('%-12s %8d %10.2f %10.1f' % (variant, count, result[0], result[1]))
+            sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
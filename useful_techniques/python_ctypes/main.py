@@ -1,5 +1,7 @@
 import os
+import errno
 import ctypes
+import numpy
 
 class Resource(ctypes.Structure):
     _fields_ = [
@@ -10,6 +12,163 @@ class Resource(ctypes.Structure):
     def __repr__(self):
         return f'model_hash={self.model_hash}\nmodel_file={self.model_file}\nmodel_range={self.model_range:.2f}'
 
-dll = ctypes.CDLL(os.path.join(os.path.dirname(__file__), './test.so'))
+# one-dimensional array descriptor, the memory stays owned by numpy
+class ArrayView(ctypes.Structure):
+    _fields_ = [
+        ('data', ctypes.c_void_p),
+        ('size', ctypes.c_int64),
+        ('stride', ctypes.c_int64),
+        ('dtype', ctypes.c_int32),
+        ('reserved', ctypes.c_int32)]
+
+# snapshot of a published shared resource, pointers refer to the shared mapping
+class SharedResourceView(ctypes.Structure):
+    _fields_ = [
+        ('version', ctypes.c_uint64),
+        ('sequence', ctypes.c_uint64),
+        ('resource', ctypes.POINTER(Resource)),
+        ('data', ctypes.c_void_p),
+        ('size', ctypes.c_uint64)]
+
+ARRAY_TYPES = {numpy.dtype(numpy.float32): 0, numpy.dtype(numpy.float64): 1}
+
+dll = ctypes.CDLL(os.path.join(os.path.dirname(__file__), './test.so'), use_errno=True)
 dll.globalResource.restype = ctypes.POINTER(Resource)
+dll.arrayStatusString.restype = ctypes.c_char_p
+dll.arrayStatusString.argtypes = [ctypes.c_int32]
+dll.arrayThreadCount.restype = ctypes.c_int32
+for name, count in (('arrayHypot', 3), ('arrayRange', 4), ('arrayAzimuth', 3), ('arrayAngle', 3)):
+    function = getattr(dll, name)
+    function.restype = ctypes.c_int32
+    function.argtypes = [ctypes.POINTER(ArrayView)] * count
+
+dll.sharedResourceCreate.restype = ctypes.c_void_p
+dll.sharedResourceCreate.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+dll.sharedResourceAttach.restype = ctypes.c_void_p
+dll.sharedResourceAttach.argtypes = [ctypes.c_char_p]
+dll.sharedResourceClose.restype = None
+dll.sharedResourceClose.argtypes = [ctypes.c_void_p]
+dll.sharedResourceUnlink.restype = ctypes.c_int32
+dll.sharedResourceUnlink.argtypes = [ctypes.c_char_p]
+dll.sharedResourcePublish.restype = ctypes.c_int32
+dll.sharedResourcePublish.argtypes = [ctypes.c_void_p, ctypes.POINTER(Resource), ctypes.c_void_p, ctypes.c_uint64]
+dll.sharedResourceAcquire.restype = ctypes.c_int32
+dll.sharedResourceAcquire.argtypes = [ctypes.c_void_p, ctypes.POINTER(SharedResourceView)]
+dll.sharedResourceValid.restype = ctypes.c_int32
+dll.sharedResourceValid.argtypes = [ctypes.c_void_p, ctypes.POINTER(SharedResourceView)]
+
+# native handle of a mapped segment, unmapped when the last reference is gone
+class SharedMapping(object):
+    def __init__(self, handle):
+        self.handle = handle
+
+    def __del__(self, close=dll.sharedResourceClose):
+        close(self.handle)
+
+# named shared memory segment with Resource metadata and bulk data, one writer and any number of readers
+class SharedResource(object):
+    def __init__(self, name, capacity=None):
+        self.name = name.encode()
+        if capacity is None:
+            handle = dll.sharedResourceAttach(self.name)
+        else:
+            handle = dll.sharedResourceCreate(self.name, capacity)
+        if not handle:
+            error = ctypes.get_errno()
+            raise OSError(error, f'cannot open shared resource {name}: {os.strerror(error)}')
+        self.mapping = SharedMapping(handle)
+
+    # the segment stays mapped until the arrays returned by acquire are released too
+    def close(self):
+        self.mapping = None
+
+    def unlink(self):
+        dll.sharedResourceUnlink(self.name)
+
+    # copy metadata and a numpy array into the inactive slot and make it current
+    def publish(self, resource, data):
+        data = numpy.ascontiguousarray(data)
+        status = dll.sharedResourcePublish(self.mapping.handle, ctypes.byref(resource), data.ctypes.data, data.nbytes)
+        if status != 0:
+            raise ValueError(f'publish failed with status {status}')
+
+    # current version as (view, metadata, read-only numpy array over the shared data) without copying,
+    # the metadata and the array hold a reference to the mapping
+    def acquire(self, dtype=numpy.float64):
+        view = SharedResourceView()
+        if dll.sharedResourceAcquire(self.mapping.handle, ctypes.byref(view)) != 0:
+            return None
+        meta = view.resource[0]
+        meta.mapping = self.mapping
+        buffer = (ctypes.c_char * view.size).from_address(view.data) if view.size else b''
+        if view.size:
+            buffer.mapping = self.mapping
+        data = numpy.frombuffer(buffer, dtype=dtype)
+        data.flags.writeable = False
+        return view, meta, data
+
+    # the arrays returned by acquire are consistent only while this is true
+    def valid(self, view):
+        return self.mapping is not None and dll.sharedResourceValid(self.mapping.handle, ctypes.byref(view)) == 1
+
+# describe a numpy vector or a strided row such as Mesh.x without copying it
+def view(array):
+    if not isinstance(array, numpy.ndarray) or array.ndim != 1:
+        raise ValueError('one-dimensional numpy array expected')
+    if array.dtype not in ARRAY_TYPES:
+        raise ValueError(f'unsupported dtype {array.dtype}')
+    return ArrayView(array.ctypes.data, array.size, array.strides[0], ARRAY_TYPES[array.dtype], 0)
+
+# call a kernel, results go to out which is allocated like the first input if omitted
+def call(function, out, *inputs):
+    if out is None:
+        out = numpy.empty_like(inputs[0])
+    elif not out.flags.writeable:
+        raise ValueError('output array is read-only')
+    status = function(*(ctypes.byref(view(array)) for array in inputs + (out,)))
+    if status != 0:
+        raise ValueError(dll.arrayStatusString(status).decode())
+    return out
+
+def hypots(x, y, out=None):
+    return call(dll.arrayHypot, out, x, y)
+
+def ranges(x, y, z, out=None):
+    return call(dll.arrayRange, out, x, y, z)
+
+def azimuths(x, y, out=None):
+    return call(dll.arrayAzimuth, out, x, y)
+
+def angles(z, h, out=None):
+    return call(dll.arrayAngle, out, z, h)
+
 print(dll.globalResource()[0])
+print('kernel threads', dll.arrayThreadCount())
+
+# the same rows as Mesh.x, Mesh.y and Mesh.z from cool_stuff/geographic_projections.py
+xyz = numpy.random.default_rng(1).uniform(-1000, 1000, (3, 1000000))
+h = hypots(xyz[0], xyz[1])
+print('hypots', numpy.allclose(h, numpy.hypot(xyz[0], xyz[1])))
+print('ranges', numpy.allclose(ranges(*xyz), numpy.sqrt(numpy.sum(xyz**2, axis=0))))
+print('azimuths', numpy.allclose(azimuths(xyz[0], xyz[1]), numpy.arctan2(xyz[0], xyz[1])))
+print('angles', numpy.allclose(angles(xyz[2], h), xyz[2] / h))
+print('strided', numpy.allclose(hypots(xyz.T[:, 0], xyz.T[:, 1]), h))
+
+writer = SharedResource('/test_resource', 8 * 1000000)
+resource = Resource(b'hash', b'model.bin', 42.0)
+writer.publish(resource, xyz[0])
+reader = SharedResource('/test_resource')
+view, meta, data = reader.acquire()
+print('shared', meta.model_file, view.version, numpy.array_equal(data, xyz[0]), reader.valid(view))
+writer.publish(resource, xyz[1])
+writer.publish(resource, xyz[2])
+print('overwritten', not reader.valid(view))
+try:
+    SharedResource('/test_resource', 8 * 1000000 - 1)
+except OSError as error:
+    print('capacity mismatch', error.errno == errno.EEXIST)
+reader.close()
+print('mapped after close', data.size == xyz.shape[1] and bool(numpy.isfinite(data).all()), meta.model_range)
+del view, meta, data
+writer.close()
+writer.unlink()
@@ -1,4 +1,24 @@
 #include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <new>
+#include <sched.h>
+#include <pthread.h>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 struct Resource {
     char model_hash[ 32 ];
@@ -14,3 +34,597 @@ extern "C" Resource* globalResource() {
     resource.model_range = 42;
     return &resource;
 }
+
+/**
+ * Resource в именованном сегменте разделяемой памяти POSIX для нескольких процессов.
+ * Сегмент содержит заголовок и два слота; слот - это Resource, размер данных и область данных
+ * емкостью capacity байт. Писатель заполняет неактивный слот и публикует его увеличением
+ * счетчика версий, активен слот с номером version % 2. Читатель получает указатели прямо
+ * в отображенную память без копирования и после работы с ними проверяет счетчик слота:
+ * писатель делает его нечетным на время записи, поэтому изменение счетчика означает,
+ * что прочитанные данные могли быть перезаписаны и снимок нужно получить заново.
+ * Писатель в каждый момент один, одновременная публикация возвращает ResourceBusy.
+ * Писателей разных процессов разделяет robust-мьютекс в заголовке сегмента: если писатель
+ * умер посреди публикации, следующий писатель получает мьютекс обратно и перезаписывает
+ * недописанный слот, версия при этом не успела увеличиться.
+ */
+enum ResourceStatus : int32_t {
+    ResourceOk = 0,
+    ResourceInvalid = -1,
+    ResourceTooLarge = -2,
+    ResourceBusy = -3,
+    ResourceReadOnly = -4,
+    ResourceEmpty = -5
+};
+
+static_assert( ATOMIC_LLONG_LOCK_FREE == 2, "shared memory counters must be lock-free" );
+
+static constexpr uint64_t SharedResourceMagic = 0x5245534f55524345ull;
+static constexpr uint32_t SharedResourceLayout = 2;
+
+struct alignas( 64 ) SharedResourceSlot {
+    std::atomic< uint64_t > sequence;
+    Resource resource;
+    uint64_t size;
+    uint64_t offset;
+};
+
+struct alignas( 64 ) SharedResourceHeader {
+    uint64_t magic;
+    uint32_t layout;
+    uint32_t reserved;
+    uint64_t capacity;
+    std::atomic< uint64_t > version;
+    pthread_mutex_t writer;
+    SharedResourceSlot slots[ 2 ];
+};
+
+/**
+ * Снимок опубликованной версии: указатели ссылаются на отображенный сегмент
+ */
+struct SharedResourceView {
+    uint64_t version;
+    uint64_t sequence;
+    const Resource* resource;
+    const void* data;
+    uint64_t size;
+};
+
+struct SharedResource {
+    int fd;
+    bool writable;
+    size_t length;
+    SharedResourceHeader* header;
+};
+
+static size_t sharedResourceLength( uint64_t capacity ) {
+    const uint64_t aligned = ( capacity + 63 ) & ~uint64_t( 63 );
+    return sizeof( SharedResourceHeader ) + 2 * aligned;
+}
+
+static SharedResource* mapSharedResource( int fd, size_t length, bool writable ) {
+    void* base = mmap( nullptr, length, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+    if ( base == MAP_FAILED ) {
+        close( fd );
+        return nullptr;
+    }
+    return new SharedResource{ fd, writable, length, static_cast< SharedResourceHeader* >( base ) };
+}
+
+static void unmapSharedResource( SharedResource* shared ) {
+    munmap( shared->header, shared->length );
+    close( shared->fd );
+    delete shared;
+}
+
+static int initWriterMutex( pthread_mutex_t* mutex ) {
+    pthread_mutexattr_t attributes;
+    int error = pthread_mutexattr_init( &attributes );
+    if ( error )
+        return error;
+    error = pthread_mutexattr_setpshared( &attributes, PTHREAD_PROCESS_SHARED );
+    if ( !error )
+        error = pthread_mutexattr_setrobust( &attributes, PTHREAD_MUTEX_ROBUST );
+    if ( !error )
+        error = pthread_mutex_init( mutex, &attributes );
+    pthread_mutexattr_destroy( &attributes );
+    return error;
+}
+
+/**
+ * Создает сегмент с областью данных capacity байт в каждом слоте или открывает существующий
+ * с той же емкостью для записи. Заголовок инициализирует только создатель сегмента (O_EXCL).
+ * Возвращает nullptr при ошибке, причина остается в errno: EEXIST - сегмент другой емкости,
+ * EINVAL - сегмент другой версии раскладки, EAGAIN - создатель еще не закончил инициализацию.
+ */
+extern "C" SharedResource* sharedResourceCreate( const char* name, uint64_t capacity ) {
+    int fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 );
+    const bool created = fd >= 0;
+    if ( !created && errno == EEXIST )
+        fd = shm_open( name, O_RDWR, 0 );
+    if ( fd < 0 )
+        return nullptr;
+
+    const size_t length = sharedResourceLength( capacity );
+    struct stat info;
+    int error = 0;
+    if ( created && ftruncate( fd, off_t( length ) ) != 0 )
+        error = errno;
+    else if ( !created && fstat( fd, &info ) != 0 )
+        error = errno;
+    else if ( !created && size_t( info.st_size ) != length )
+        error = info.st_size ? EEXIST : EAGAIN;
+
+    SharedResource* shared = nullptr;
+    if ( error )
+        close( fd );
+    else if ( !( shared = mapSharedResource( fd, length, true ) ) )
+        error = errno;
+    else if ( created )
+        error = initWriterMutex( &shared->header->writer );
+    else if ( shared->header->magic != SharedResourceMagic )
+        error = EAGAIN;
+    else if ( shared->header->layout != SharedResourceLayout )
+        error = EINVAL;
+    else if ( shared->header->capacity != capacity )
+        error = EEXIST;
+
+    if ( error ) {
+        if ( shared )
+            unmapSharedResource( shared );
+        if ( created )
+            shm_unlink( name );
+        errno = error;
+        return nullptr;
+    }
+
+    SharedResourceHeader* header = shared->header;
+    if ( created ) {
+        // --- новый сегмент заполнен нулями: нулевая версия означает, что публикаций еще не было
+        const uint64_t aligned = ( capacity + 63 ) & ~uint64_t( 63 );
+        header->layout = SharedResourceLayout;
+        header->capacity = capacity;
+        header->slots[ 0 ].offset = sizeof( SharedResourceHeader );
+        header->slots[ 1 ].offset = sizeof( SharedResourceHeader ) + aligned;
+        std::atomic_thread_fence( std::memory_order_release );
+        header->magic = SharedResourceMagic;
+    }
+    return shared;
+}
+
+/**
+ * Открывает существующий сегмент только для чтения
+ */
+extern "C" SharedResource* sharedResourceAttach( const char* name ) {
+    int fd = shm_open( name, O_RDONLY, 0 );
+    if ( fd < 0 )
+        return nullptr;
+
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 || size_t( info.st_size ) < sizeof( SharedResourceHeader ) ) {
+        close( fd );
+        errno = EINVAL;
+        return nullptr;
+    }
+
+    SharedResource* shared = mapSharedResource( fd, size_t( info.st_size ), false );
+    if ( shared && ( shared->header->magic != SharedResourceMagic || shared->header->layout != SharedResourceLayout ||
+            sharedResourceLength( shared->header->capacity ) != shared->length ) ) {
+        unmapSharedResource( shared );
+        errno = EINVAL;
+        return nullptr;
+    }
+    return shared;
+}
+
+extern "C" void sharedResourceClose( SharedResource* shared ) {
+    if ( shared )
+        unmapSharedResource( shared );
+}
+
+extern "C" int32_t sharedResourceUnlink( const char* name ) {
+    return shm_unlink( name ) == 0 ? ResourceOk : ResourceInvalid;
+}
+
+extern "C" uint64_t sharedResourceCapacity( const SharedResource* shared ) {
+    return shared ? shared->header->capacity : 0;
+}
+
+/**
+ * Публикует новую версию: метаданные и size байт данных
+ */
+extern "C" int32_t sharedResourcePublish( SharedResource* shared, const Resource* resource, const void* data, uint64_t size ) {
+    if ( !shared || !resource || ( !data && size ) )
+        return ResourceInvalid;
+    if ( !shared->writable )
+        return ResourceReadOnly;
+
+    SharedResourceHeader* header = shared->header;
+    if ( size > header->capacity )
+        return ResourceTooLarge;
+    const int locked = pthread_mutex_trylock( &header->writer );
+    if ( locked == EBUSY )
+        return ResourceBusy;
+    if ( locked == EOWNERDEAD )
+        pthread_mutex_consistent( &header->writer );
+    else if ( locked )
+        return ResourceInvalid;
+
+    // --- после умершего писателя счетчик слота может остаться нечетным, он таким и остается до конца записи
+    const uint64_t version = header->version.load( std::memory_order_relaxed ) + 1;
+    SharedResourceSlot& slot = header->slots[ version % 2 ];
+    const uint64_t sequence = slot.sequence.load( std::memory_order_relaxed ) | 1;
+    slot.sequence.store( sequence, std::memory_order_relaxed );
+    std::atomic_thread_fence( std::memory_order_release );
+
+    slot.resource = *resource;
+    slot.size = size;
+    if ( size )
+        std::memcpy( reinterpret_cast< char* >( header ) + slot.offset, data, size_t( size ) );
+
+    slot.sequence.store( sequence + 1, std::memory_order_release );
+    header->version.store( version, std::memory_order_release );
+    pthread_mutex_unlock( &header->writer );
+    return ResourceOk;
+}
+
+/**
+ * Заполняет view последней опубликованной версией без копирования данных
+ */
+extern "C" int32_t sharedResourceAcquire( const SharedResource* shared, SharedResourceView* view ) {
+    if ( !shared || !view )
+        return ResourceInvalid;
+
+    const SharedResourceHeader* header = shared->header;
+    for ( ;; ) {
+        const uint64_t version = header->version.load( std::memory_order_acquire );
+        if ( !version )
+            return ResourceEmpty;
+
+        // --- нечетный счетчик: писатель успел дважды опубликовать и снова пишет в этот слот
+        const SharedResourceSlot& slot = header->slots[ version % 2 ];
+        const uint64_t sequence = slot.sequence.load( std::memory_order_acquire );
+        if ( sequence & 1 )
+            continue;
+
+        view->version = version;
+        view->sequence = sequence;
+        view->resource = &slot.resource;
+        view->data = reinterpret_cast< const char* >( header ) + slot.offset;
+        // --- при гонке с писателем размер может быть прочитан неверно, но не выйдет за границы слота
+        view->size = std::min( slot.size, header->capacity );
+        return ResourceOk;
+    }
+}
+
+/**
+ * 1, если данные view еще не начали перезаписываться, иначе 0 и view нужно получить заново
+ */
+extern "C" int32_t sharedResourceValid( const SharedResource* shared, const SharedResourceView* view ) {
+    if ( !shared || !view )
+        return 0;
+    std::atomic_thread_fence( std::memory_order_acquire );
+    const SharedResourceSlot& slot = shared->header->slots[ view->version % 2 ];
+    return slot.sequence.load( std::memory_order_relaxed ) == view->sequence;
+}
+
+/**
+ * Описание одномерного массива вызывающей стороны, например numpy.ndarray:
+ * адрес первого элемента, число элементов, шаг между элементами в байтах и тип элементов.
+ * Ядра читают и пишут массивы на месте, без копирования и без вызовов Python на элемент.
+ * Результат пишется в массив, выделенный вызывающей стороной; он может совпадать с одним из входов.
+ */
+enum ArrayType : int32_t {
+    ArrayFloat32 = 0,
+    ArrayFloat64 = 1
+};
+
+enum ArrayStatus : int32_t {
+    ArrayOk = 0,
+    ArrayNull = -1,
+    ArraySizeMismatch = -2,
+    ArrayTypeUnsupported = -3,
+    ArrayTypeMismatch = -4
+};
+
+struct ArrayView {
+    void* data;
+    int64_t size;
+    int64_t stride;
+    int32_t dtype;
+    int32_t reserved;
+};
+
+extern "C" const char* arrayStatusString( int32_t status ) {
+    switch ( status ) {
+    case ArrayOk: return "ok";
+    case ArrayNull: return "null array";
+    case ArraySizeMismatch: return "array sizes differ";
+    case ArrayTypeUnsupported: return "unsupported array dtype";
+    case ArrayTypeMismatch: return "input arrays have different dtypes";
+    default: return "unknown status";
+    }
+}
+
+/**
+ * Доступ к элементам массива с произвольным шагом. Для непрерывных массивов
+ * вместо него используется обычный указатель, чтобы компилятор мог векторизовать цикл.
+ */
+template< typename T >
+struct Strided {
+    char* data;
+    int64_t stride;
+
+    T& operator[]( int64_t index ) const {
+        return *reinterpret_cast< T* >( data + index * stride );
+    }
+};
+
+template< typename T, bool Contiguous >
+struct Access {
+    static T* make( const ArrayView& view ) {
+        return static_cast< T* >( view.data );
+    }
+};
+
+template< typename T >
+struct Access< T, false > {
+    static Strided< T > make( const ArrayView& view ) {
+        return { static_cast< char* >( view.data ), view.stride };
+    }
+};
+
+static int64_t itemSize( int32_t dtype ) {
+    switch ( dtype ) {
+    case ArrayFloat32: return sizeof( float );
+    case ArrayFloat64: return sizeof( double );
+    default: return 0;
+    }
+}
+
+static bool contiguous( const ArrayView& view ) {
+    return view.stride == itemSize( view.dtype );
+}
+
+static int32_t validate( const ArrayView* view, int64_t size ) {
+    if ( !view || ( !view->data && view->size ) )
+        return ArrayNull;
+    if ( view->size != size )
+        return ArraySizeMismatch;
+    if ( !itemSize( view->dtype ) )
+        return ArrayTypeUnsupported;
+    return ArrayOk;
+}
+
+/**
+ * Пул рабочих потоков, общий для всех вызовов ядер в процессе.
+ * Создается при первом вызове, размер равен числу процессоров в маске привязки процесса.
+ * ctypes отпускает GIL на время вызова, поэтому один вызов из Python занимает все ядра.
+ * Вызывающий поток только ждет завершения своих частей, а задания нескольких одновременных
+ * вызовов выполняются теми же рабочими потоками, поэтому вычисляющих потоков не больше размера пула.
+ * Пул не разрушается при выходе из процесса, чтобы не зависеть от порядка выгрузки библиотеки;
+ * в дочернем процессе после fork создается новый пул, так как потоки родителя не копируются.
+ */
+class WorkerPool {
+public:
+    static WorkerPool& instance() {
+        static const int registered = pthread_atfork( nullptr, nullptr, [] {
+            // --- потоков родителя в дочернем процессе нет, блокировка могла остаться захваченной
+            new ( &s_mutex ) std::mutex;
+            s_instance = nullptr;
+        } );
+        ( void ) registered;
+        std::lock_guard< std::mutex > lock( s_mutex );
+        if ( !s_instance )
+            s_instance = new WorkerPool( affinityCount() );
+        return *s_instance;
+    }
+
+    size_t size() const {
+        return m_threads.size();
+    }
+
+    /**
+     * Выполняет function( part ) для part из [ 0, parts ) и возвращает управление после всех частей
+     */
+    template< typename Function >
+    void run( size_t parts, const Function& function ) {
+        Job job{ &function, &call< Function >, parts };
+        std::unique_lock< std::mutex > lock( m_mutex );
+        m_jobs.push_back( &job );
+        m_work.notify_all();
+        m_finished.wait( lock, [ &job ] { return job.done == job.count; } );
+    }
+
+private:
+    struct Job {
+        const void* context;
+        void ( *invoke )( const void*, size_t );
+        size_t count;
+        size_t next = 0;
+        size_t done = 0;
+    };
+
+    explicit WorkerPool( size_t size ) {
+        for ( size_t i = 0; i < size; ++i )
+            m_threads.emplace_back( [ this ] { work(); } );
+    }
+
+    static size_t affinityCount() {
+        cpu_set_t set;
+        if ( sched_getaffinity( 0, sizeof( set ), &set ) == 0 && CPU_COUNT( &set ) > 0 )
+            return size_t( CPU_COUNT( &set ) );
+        return std::max( 1u, std::thread::hardware_concurrency() );
+    }
+
+    template< typename Function >
+    static void call( const void* context, size_t part ) {
+        ( *static_cast< const Function* >( context ) )( part );
+    }
+
+    void work() {
+        std::unique_lock< std::mutex > lock( m_mutex );
+        for ( ;; ) {
+            m_work.wait( lock, [ this ] { return !m_jobs.empty(); } );
+            Job* job = m_jobs.front();
+            const size_t part = job->next++;
+            if ( job->next == job->count )
+                m_jobs.pop_front();
+
+            lock.unlock();
+            job->invoke( job->context, part );
+            lock.lock();
+
+            if ( ++job->done == job->count )
+                m_finished.notify_all();
+        }
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_work;
+    std::condition_variable m_finished;
+    std::deque< Job* > m_jobs;
+    std::vector< std::thread > m_threads;
+
+    static WorkerPool* s_instance;
+    static std::mutex s_mutex;
+};
+
+WorkerPool* WorkerPool::s_instance = nullptr;
+std::mutex WorkerPool::s_mutex;
+
+/**
+ * Делит [ 0, size ) на равные части не короче MinPart элементов, не больше одной на поток пула.
+ * Короткие массивы обрабатываются в вызывающем потоке без обращения к пулу.
+ */
+static constexpr int64_t MinPart = 1 << 15;
+
+template< typename Function >
+static void parallelFor( int64_t size, const Function& function ) {
+    const int64_t parts = size / MinPart;
+    if ( parts < 2 ) {
+        function( int64_t( 0 ), size );
+        return;
+    }
+
+    WorkerPool& pool = WorkerPool::instance();
+    const int64_t count = std::min( parts, int64_t( pool.size() ) );
+    if ( count < 2 ) {
+        function( int64_t( 0 ), size );
+        return;
+    }
+    pool.run( size_t( count ), [ & ]( size_t part ) {
+        function( size * int64_t( part ) / count, size * int64_t( part + 1 ) / count );
+    } );
+}
+
+extern "C" int32_t arrayThreadCount() {
+    return int32_t( WorkerPool::instance().size() );
+}
+
+/**
+ * Выбор типов и способа доступа выполняется один раз на вызов:
+ * все входы должны иметь один тип, выход может иметь другой.
+ * Ядро получает диапазон индексов [ begin, end ), выход и входы; большие массивы делятся между потоками пула.
+ */
+template< typename In, typename Out, bool Contiguous, typename Kernel, typename... Views >
+static int32_t invoke( const Kernel& kernel, const ArrayView& out, const Views&... in ) {
+    parallelFor( out.size, [ & ]( int64_t begin, int64_t end ) {
+        kernel( begin, end, Access< Out, Contiguous >::make( out ), Access< In, Contiguous >::make( in )... );
+    } );
+    return ArrayOk;
+}
+
+template< typename In, typename Out, typename Kernel, typename... Views >
+static int32_t dispatchLayout( const Kernel& kernel, const ArrayView& out, const Views&... in ) {
+    const bool dense[] = { contiguous( out ), contiguous( in )... };
+    for ( bool item : dense ) {
+        if ( !item )
+            return invoke< In, Out, false >( kernel, out, in... );
+    }
+    return invoke< In, Out, true >( kernel, out, in... );
+}
+
+template< typename In, typename Kernel, typename... Views >
+static int32_t dispatchOut( const Kernel& kernel, const ArrayView& out, const Views&... in ) {
+    switch ( out.dtype ) {
+    case ArrayFloat32: return dispatchLayout< In, float >( kernel, out, in... );
+    case ArrayFloat64: return dispatchLayout< In, double >( kernel, out, in... );
+    default: return ArrayTypeUnsupported;
+    }
+}
+
+template< typename Kernel, typename... Views >
+static int32_t dispatch( const Kernel& kernel, const ArrayView* out, const Views*... in ) {
+    if ( !out )
+        return ArrayNull;
+    const int32_t status[] = { validate( out, out->size ), validate( in, out->size )... };
+    for ( int32_t item : status ) {
+        if ( item != ArrayOk )
+            return item;
+    }
+
+    const int32_t types[] = { in->dtype... };
+    for ( int32_t type : types ) {
+        if ( type != types[ 0 ] )
+            return ArrayTypeMismatch;
+    }
+
+    switch ( types[ 0 ] ) {
+    case ArrayFloat32: return dispatchOut< float >( kernel, *out, *in... );
+    case ArrayFloat64: return dispatchOut< double >( kernel, *out, *in... );
+    default: return ArrayTypeUnsupported;
+    }
+}
+
+/**
+ * Ядра повторяют вычисления Mesh из cool_stuff/geographic_projections.py.
+ */
+struct HypotKernel {
+    template< typename Out, typename In >
+    void operator()( int64_t begin, int64_t end, Out out, In x, In y ) const {
+        for ( int64_t i = begin; i < end; ++i )
+            out[ i ] = std::hypot( x[ i ], y[ i ] );
+    }
+};
+
+struct RangeKernel {
+    template< typename Out, typename In >
+    void operator()( int64_t begin, int64_t end, Out out, In x, In y, In z ) const {
+        for ( int64_t i = begin; i < end; ++i )
+            out[ i ] = std::sqrt( x[ i ] * x[ i ] + y[ i ] * y[ i ] + z[ i ] * z[ i ] );
+    }
+};
+
+struct AzimuthKernel {
+    template< typename Out, typename In >
+    void operator()( int64_t begin, int64_t end, Out out, In x, In y ) const {
+        for ( int64_t i = begin; i < end; ++i )
+            out[ i ] = std::atan2( x[ i ], y[ i ] );
+    }
+};
+
+struct AngleKernel {
+    template< typename Out, typename In >
+    void operator()( int64_t begin, int64_t end, Out out, In z, In h ) const {
+        using Value = typename std::decay< decltype( out[ 0 ] ) >::type;
+        for ( int64_t i = begin; i < end; ++i )
+            out[ i ] = h[ i ] != 0 ? Value( z[ i ] / h[ i ] ) : -std::numeric_limits< Value >::max();
+    }
+};
+
+extern "C" int32_t arrayHypot( const ArrayView* x, const ArrayView* y, const ArrayView* out ) {
+    return dispatch( HypotKernel(), out, x, y );
+}
+
+extern "C" int32_t arrayRange( const ArrayView* x, const ArrayView* y, const ArrayView* z, const ArrayView* out ) {
+    return dispatch( RangeKernel(), out, x, y, z );
+}
+
+extern "C" int32_t arrayAzimuth( const ArrayView* x, const ArrayView* y, const ArrayView* out ) {
+    return dispatch( AzimuthKernel(), out, x, y );
+}
+
+extern "C" int32_t arrayAngle( const ArrayView* z, const ArrayView* h, const ArrayView* out ) {
+    return dispatch( AngleKernel(), out, z, h );
+}
@@ -2,18 +2,190 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <QString>
+#include <QFile>
+#include <QStringList>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 /**
- * Собственная реализация функции QProcess::startDetached, которая не умеет перенаправлять ввод/вывод.
- * Запускает команду program с заданными аргументами arguments в новом процессе и отцепляется от него.
- * Перенаправляет весь ввод и вывод исполняемой команды в файлы inputFile и outputFile соответственно.
- * Если файл не указан, то потоки перенавляются в /dev/null.
+ * Сборщик вывода отцепленных процессов.
+ * Каждый процесс пишет в собственный канал (pipe), а поток сборщика через один цикл epoll
+ * переносит данные из каналов в лог-файлы вызовом splice, не копируя их в пространство пользователя.
+ * Лог-файл ротируется по достижении maxSize байт: file -> file.1 -> ... -> file.maxFiles.
+ * Канал закрывается сборщиком, когда все процессы, владеющие его концом на запись, завершились.
  */
-void startDetached( const QString &program, const QStringList &arguments = QStringList(),
-      const QString &inputFile = QString(), const QString &outputFile = QString() ) {
+class OutputCollector {
+public:
+   OutputCollector() {
+      m_epoll = epoll_create1( EPOLL_CLOEXEC );
+      m_wakeup = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+
+      epoll_event event{};
+      event.events = EPOLLIN;
+      event.data.fd = m_wakeup;
+      epoll_ctl( m_epoll, EPOLL_CTL_ADD, m_wakeup, &event );
+
+      m_thread = std::thread( &OutputCollector::run, this );
+   }
+
+   ~OutputCollector() {
+      m_running = false;
+      uint64_t value = 1;
+      write( m_wakeup, &value, sizeof( value ) );
+      m_thread.join();
+
+      for ( auto& sink : m_sinks ) {
+         close( sink.first );
+         close( sink.second.file );
+      }
+      close( m_wakeup );
+      close( m_epoll );
+   }
+
+   OutputCollector( const OutputCollector& ) = delete;
+   OutputCollector& operator=( const OutputCollector& ) = delete;
+
+   /**
+    * Создает канал, данные из которого будут записываться в лог-файл logFile.
+    * Возвращает дескриптор канала на запись, который нужно передать процессу и закрыть у себя.
+    * В случае ошибки возвращает -1.
+    */
+   int attach( const QString &logFile, off_t maxSize = 64 << 20, int maxFiles = 4 ) {
+      Sink sink;
+      sink.path = QFile::encodeName( logFile );
+      sink.maxSize = maxSize;
+      sink.maxFiles = maxFiles;
+      if ( !sink.open() )
+         return -1;
+
+      int fds[ 2 ];
+      if ( pipe2( fds, O_CLOEXEC ) == -1 ) {
+         close( sink.file );
+         return -1;
+      }
+
+      // --- большой буфер канала сокращает число пробуждений сборщика для болтливых процессов
+      fcntl( fds[ 0 ], F_SETPIPE_SZ, 1 << 20 );
+      fcntl( fds[ 0 ], F_SETFL, O_NONBLOCK );
+
+      {
+         std::lock_guard< std::mutex > lock( m_mutex );
+         m_sinks.emplace( fds[ 0 ], std::move( sink ) );
+      }
+
+      epoll_event event{};
+      event.events = EPOLLIN | EPOLLRDHUP;
+      event.data.fd = fds[ 0 ];
+      epoll_ctl( m_epoll, EPOLL_CTL_ADD, fds[ 0 ], &event );
+      return fds[ 1 ];
+   }
+
+private:
+   struct Sink {
+      QByteArray path;
+      int file = -1;
+      off_t written = 0;
+      off_t maxSize = 0;
+      int maxFiles = 0;
+
+      bool open() {
+         // --- splice не работает с O_APPEND, поэтому дописываем в конец вручную
+         file = ::open( path.constData(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666 );
+         if ( file == -1 )
+            return false;
+         written = lseek( file, 0, SEEK_END );
+         return written != -1;
+      }
+
+      void rotate() {
+         close( file );
+         for ( int i = maxFiles - 1; i > 0; --i ) {
+            rename( ( path + '.' + QByteArray::number( i ) ).constData(),
+                  ( path + '.' + QByteArray::number( i + 1 ) ).constData() );
+         }
+         if ( maxFiles > 0 )
+            rename( path.constData(), ( path + ".1" ).constData() );
+         else
+            unlink( path.constData() );
+         open();
+      }
+   };
+
+   void run() {
+      epoll_event events[ 64 ];
+      while ( m_running ) {
+         int count = epoll_wait( m_epoll, events, 64, -1 );
+         for ( int i = 0; i < count; ++i ) {
+            int fd = events[ i ].data.fd;
+            if ( fd == m_wakeup )
+               continue;
+
+            std::unique_lock< std::mutex > lock( m_mutex );
+            auto it = m_sinks.find( fd );
+            if ( it == m_sinks.end() )
+               continue;
+            Sink& sink = it->second;
+            lock.unlock();
+
+            if ( !drain( fd, sink ) ) {
+               epoll_ctl( m_epoll, EPOLL_CTL_DEL, fd, nullptr );
+               close( fd );
+               close( sink.file );
+               lock.lock();
+               m_sinks.erase( fd );
+            }
+         }
+      }
+   }
+
+   /**
+    * Переносит все доступные данные канала в лог-файл.
+    * Возвращает false, если все писатели закрыли канал.
+    */
+   bool drain( int fd, Sink& sink ) {
+      for ( ;; ) {
+         if ( sink.maxSize > 0 && sink.written >= sink.maxSize )
+            sink.rotate();
+         if ( sink.file == -1 )
+            return false;
+
+         size_t chunk = sink.maxSize > 0 ? size_t( sink.maxSize - sink.written ) : size_t( 1 << 20 );
+         ssize_t moved = splice( fd, nullptr, sink.file, nullptr, std::min< size_t >( chunk, 1 << 20 ),
+               SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+         if ( moved > 0 )
+            sink.written += moved;
+         else if ( moved == 0 )
+            return false;
+         else if ( errno == EINTR )
+            continue;
+         else
+            return errno == EAGAIN;
+      }
+   }
+
+   int m_epoll = -1;
+   int m_wakeup = -1;
+   std::atomic< bool > m_running{ true };
+   std::mutex m_mutex;
+   std::unordered_map< int, Sink > m_sinks;
+   std::thread m_thread;
+};
+
+/**
+ * Запускает команду в отцепленном процессе с уже подготовленными дескрипторами ввода и вывода.
+ * Дескрипторы остаются открытыми в вызывающем процессе, закрывать их нужно самостоятельно.
+ */
+void startDetached( const QString &program, const QStringList &arguments, int inputFd, int outputFd ) {
 
    pid_t forkPid = fork();
    if ( forkPid == 0 ) {
@@ -26,20 +198,22 @@ void startDetached( const QString &program, const QStringList &arguments = QStri
          chdir( "/" );
          umask( 0 );
 
-         QFile in( !inputFile.isEmpty() ? inputFile : QStringLiteral( "/dev/null" ) );
-         if ( in.open( QIODevice::ReadOnly ) ) {
-            dup2( in.handle(), STDIN_FILENO );
-            in.close();
-         }
+         // --- dup2 не трогает дескриптор, уже совпадающий с целевым, поэтому закрываются
+         // --- только переданные дескрипторы вне стандартных, каждый один раз
+         if ( inputFd != -1 && inputFd != STDIN_FILENO )
+            dup2( inputFd, STDIN_FILENO );
 
-         QFile out( !outputFile.isEmpty() ? outputFile : QStringLiteral( "/dev/null" ) );
-         out.setPermissions( static_cast< QFileDevice::Permission >( 0x6666 ) );
-         if ( out.open( QIODevice::WriteOnly ) ) {
-            dup2( out.handle(), STDOUT_FILENO );
+         if ( outputFd != -1 ) {
+            if ( outputFd != STDOUT_FILENO )
+               dup2( outputFd, STDOUT_FILENO );
             dup2( STDOUT_FILENO, STDERR_FILENO );
-            out.close();
          }
 
+         if ( inputFd > STDERR_FILENO )
+            close( inputFd );
+         if ( outputFd > STDERR_FILENO && outputFd != inputFd )
+            close( outputFd );
+
          int argc = arguments.size() + 2;
          char **argv = new char*[ argc ];
          argv[ 0 ] = qstrdup( program.toUtf8().constData() );
@@ -67,3 +241,40 @@ void startDetached( const QString &program, const QStringList &arguments = QStri
 
    waitpid( forkPid, nullptr, 0 );
 }
+
+/**
+ * Собственная реализация функции QProcess::startDetached, которая не умеет перенаправлять ввод/вывод.
+ * Запускает команду program с заданными аргументами arguments в новом процессе и отцепляется от него.
+ * Перенаправляет весь ввод и вывод исполняемой команды в файлы inputFile и outputFile соответственно.
+ * Если файл не указан, то потоки перенавляются в /dev/null.
+ */
+void startDetached( const QString &program, const QStringList &arguments = QStringList(),
+      const QString &inputFile = QString(), const QString &outputFile = QString() ) {
+
+   QFile in( !inputFile.isEmpty() ? inputFile : QStringLiteral( "/dev/null" ) );
+   in.open( QIODevice::ReadOnly );
+
+   // --- права выставляются после открытия, когда файл уже гарантированно существует
+   QFile out( !outputFile.isEmpty() ? outputFile : QStringLiteral( "/dev/null" ) );
+   if ( out.open( QIODevice::WriteOnly ) && !outputFile.isEmpty() )
+      out.setPermissions( static_cast< QFileDevice::Permission >( 0x6666 ) );
+
+   startDetached( program, arguments, in.handle(), out.handle() );
+}
+
+/**
+ * Запускает команду с перенаправлением вывода в канал сборщика collector.
+ * Вывод процесса попадает в ротируемый лог-файл logFile.
+ */
+void startDetached( OutputCollector &collector, const QString &logFile,
+      const QString &program, const QStringList &arguments = QStringList(),
+      const QString &inputFile = QString() ) {
+
+   QFile in( !inputFile.isEmpty() ? inputFile : QStringLiteral( "/dev/null" ) );
+   in.open( QIODevice::ReadOnly );
+
+   int outputFd = collector.attach( logFile );
+   startDetached( program, arguments, in.handle(), outputFd );
+   if ( outputFd != -1 )
+      close( outputFd );
+}